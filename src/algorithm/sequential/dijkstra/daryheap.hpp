@@ -0,0 +1,114 @@
+#ifndef ALGORITHM_SEQUENTIAL_DIJKSTRA_DARYHEAP_HPP_
+#define ALGORITHM_SEQUENTIAL_DIJKSTRA_DARYHEAP_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+
+namespace gr8 { namespace algorithm { namespace sequential {
+
+/**
+ * Indexed d-ary heap with decrease-key. Each vertex appears at most once in the heap: pushing a vertex
+ * that is already present only decreases its key, so the size of the heap is bounded by the number of
+ * vertices and it never returns stale entries.
+ */
+template<typename vertex_t, typename distance_t, std::size_t arity = 4>
+class IndexedDaryHeap {
+public:
+    struct pair { vertex_t dst; distance_t cost; };
+private:
+    static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+    pair* heap; // capacity: the number of vertices
+    std::size_t* position; // position of each vertex in the heap, NONE if not present
+    std::size_t hsize;
+
+    IndexedDaryHeap(const IndexedDaryHeap&) = delete;
+    IndexedDaryHeap& operator=(const IndexedDaryHeap&) = delete;
+
+    void sift_up(std::size_t i){
+        pair p = heap[i];
+        while(i > 0){
+            std::size_t parent = (i -1) / arity;
+            if(heap[parent].cost <= p.cost) break;
+            heap[i] = heap[parent];
+            position[heap[i].dst] = i;
+            i = parent;
+        }
+        heap[i] = p;
+        position[p.dst] = i;
+    }
+
+    void sift_down(std::size_t i){
+        pair p = heap[i];
+        while(true){
+            std::size_t first = i * arity +1;
+            if(first >= hsize) break;
+            std::size_t last = first + arity < hsize ? first + arity : hsize;
+            std::size_t min = first;
+            for(std::size_t c = first +1; c < last; c++){
+                if(heap[c].cost < heap[min].cost) min = c;
+            }
+            if(heap[min].cost >= p.cost) break;
+            heap[i] = heap[min];
+            position[heap[i].dst] = i;
+            i = min;
+        }
+        heap[i] = p;
+        position[p.dst] = i;
+    }
+
+public:
+    IndexedDaryHeap(std::size_t num_vertices) : heap(new pair[num_vertices]), position(new std::size_t[num_vertices]), hsize(0) {
+        for(std::size_t i = 0; i < num_vertices; i++){
+            position[i] = NONE;
+        }
+    }
+
+    ~IndexedDaryHeap(){
+        delete[] heap;
+        delete[] position;
+    }
+
+    // insert the vertex or decrease its key
+    void push(pair p){
+        std::size_t i = position[p.dst];
+        if(i == NONE){
+            heap[hsize] = p;
+            sift_up(hsize++);
+        } else if(p.cost < heap[i].cost){
+            heap[i].cost = p.cost;
+            sift_up(i);
+        }
+    }
+
+    pair front(){
+        assert(!empty());
+        return heap[0];
+    }
+
+    void pop(){
+        assert(!empty());
+        position[heap[0].dst] = NONE;
+        hsize--;
+        if(hsize > 0){
+            heap[0] = heap[hsize];
+            sift_down(0);
+        }
+    }
+
+    bool empty() const noexcept {
+        return hsize == 0;
+    }
+
+    void clear() {
+        for(std::size_t i = 0; i < hsize; i++){
+            position[heap[i].dst] = NONE;
+        }
+        hsize = 0;
+    }
+};
+
+}}} // namespace gr8::algorithm::sequential
+
+#endif /* ALGORITHM_SEQUENTIAL_DIJKSTRA_DARYHEAP_HPP_ */
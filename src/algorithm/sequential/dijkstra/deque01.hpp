@@ -0,0 +1,95 @@
+#ifndef ALGORITHM_SEQUENTIAL_DIJKSTRA_DEQUE01_HPP_
+#define ALGORITHM_SEQUENTIAL_DIJKSTRA_DEQUE01_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <cstring> // memcpy
+
+namespace gr8 { namespace algorithm { namespace sequential {
+
+/**
+ * Double ended queue for the 0-1 BFS, when all weights are either 0 or 1. The queue only holds the keys
+ * `lastmin' and `lastmin +1', an item with the same key of the last extracted min goes to the front,
+ * otherwise to the back.
+ */
+template<typename vertex_t, typename distance_t>
+class Deque01 {
+public:
+    struct pair { vertex_t dst; distance_t cost; };
+private:
+    static constexpr std::size_t INITIAL_CAPACITY = 1024; // arbitrary value
+
+    pair* queue;
+    std::size_t startpos;
+    std::size_t endpos;
+    std::size_t capacity;
+    distance_t lastmin;
+
+    Deque01(const Deque01&) = delete;
+    Deque01& operator=(const Deque01&) = delete;
+
+    // double the capacity of the queue
+    void expand(){
+        assert(endpos == startpos);
+
+        // copy the content of the old container
+        pair* queue_cpy = new pair[capacity*2];
+        auto first_chunk_length = capacity - startpos;
+        memcpy(queue_cpy, queue + startpos, first_chunk_length * sizeof(pair));
+        memcpy(queue_cpy + first_chunk_length, queue, startpos * sizeof(pair));
+
+        // update the internal indices
+        startpos = 0;
+        endpos = capacity;
+        capacity *= 2;
+
+        // switch to the new queue
+        delete[] queue;
+        queue = queue_cpy;
+    }
+
+public:
+    Deque01() : queue(new pair[INITIAL_CAPACITY]), startpos(0), endpos(0), capacity(INITIAL_CAPACITY), lastmin(0) { }
+
+    ~Deque01(){
+        delete[] queue;
+    }
+
+    void push(pair p){
+        assert((p.cost == lastmin || p.cost == lastmin +1) && "Only weights 0 and 1 are allowed");
+        if(p.cost == lastmin){ // front
+            startpos = (startpos + capacity -1) % capacity;
+            queue[startpos] = p;
+        } else { // back
+            queue[endpos] = p;
+            endpos = (endpos +1) % capacity;
+        }
+        if(endpos == startpos){ // realloc
+            expand();
+        }
+    }
+
+    pair front(){
+        assert(!empty());
+        return queue[startpos];
+    }
+
+    void pop(){
+        assert(!empty());
+        lastmin = queue[startpos].cost;
+        startpos = (startpos +1) % capacity;
+    }
+
+    bool empty() const noexcept {
+        return startpos == endpos;
+    }
+
+    void clear() {
+        startpos = endpos = 0;
+        lastmin = 0;
+    }
+};
+
+}}} // namespace gr8::algorithm::sequential
+
+#endif /* ALGORITHM_SEQUENTIAL_DIJKSTRA_DEQUE01_HPP_ */
@@ -0,0 +1,102 @@
+#ifndef ALGORITHM_SEQUENTIAL_DIJKSTRA_DIAL_HPP_
+#define ALGORITHM_SEQUENTIAL_DIJKSTRA_DIAL_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <cstring> // memcpy
+
+namespace gr8 { namespace algorithm { namespace sequential {
+
+/**
+ * Dial's bucket queue, for integer weights in the range [0, max_weight]. All keys in the queue are within
+ * [min, min + max_weight], so a circular array of max_weight +1 buckets indexed by key modulo the number
+ * of buckets is enough. Keys must be non decreasing w.r.t. the last extracted min.
+ */
+template<typename vertex_t, typename distance_t>
+class Dial {
+public:
+    struct pair { vertex_t dst; distance_t cost; };
+private:
+    static constexpr std::size_t INITIAL_CAPACITY = 16; // arbitrary value
+
+    const std::size_t num_buckets;
+    std::size_t* capacity;
+    std::size_t* size;
+    pair** buckets;
+    std::size_t cursor; // bucket of the current min
+    std::size_t hsize; // total number of elements in the queue
+
+    Dial(const Dial&) = delete;
+    Dial& operator=(const Dial&) = delete;
+
+    std::size_t get_bucket_index(distance_t key) const {
+        return static_cast<std::size_t>(key) % num_buckets;
+    }
+
+    // move the cursor to the first non empty bucket
+    void pull0(){
+        assert(!empty());
+        while(size[cursor] == 0){ cursor = (cursor +1) % num_buckets; }
+    }
+
+public:
+    Dial(std::size_t max_weight) : num_buckets(max_weight +1),
+        capacity(new std::size_t[num_buckets]), size(new std::size_t[num_buckets]), buckets(new pair*[num_buckets]),
+        cursor(0), hsize(0) {
+        for(std::size_t i = 0; i < num_buckets; i++){
+            capacity[i] = INITIAL_CAPACITY;
+            size[i] = 0;
+            buckets[i] = new pair[capacity[i]];
+        }
+    }
+
+    ~Dial(){
+        for(std::size_t i = 0; i < num_buckets; i++){
+            delete[] buckets[i];
+        }
+        delete[] buckets;
+        delete[] size;
+        delete[] capacity;
+    }
+
+    void push(pair p){
+        std::size_t i = get_bucket_index(p.cost);
+        if(size[i] >= capacity[i]){ // realloc
+            capacity[i] *= 2;
+            pair* temp = new pair[capacity[i]];
+            memcpy(temp, buckets[i], sizeof(pair) * size[i]);
+            delete[] buckets[i];
+            buckets[i] = temp;
+        }
+        buckets[i][size[i]++] = p;
+        hsize++;
+    }
+
+    pair front(){
+        pull0();
+        return buckets[cursor][size[cursor] -1];
+    }
+
+    void pop(){
+        pull0();
+        size[cursor]--;
+        hsize--;
+    }
+
+    bool empty() const noexcept {
+        return hsize == 0;
+    }
+
+    void clear() {
+        cursor = 0;
+        if(empty()) return;
+        hsize = 0;
+        for(std::size_t i = 0; i < num_buckets; i++){
+            size[i] = 0;
+        }
+    }
+};
+
+}}} // namespace gr8::algorithm::sequential
+
+#endif /* ALGORITHM_SEQUENTIAL_DIJKSTRA_DIAL_HPP_ */
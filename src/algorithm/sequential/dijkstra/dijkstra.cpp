@@ -11,6 +11,7 @@
 
 #include <cassert>
 #include <memory>
+#include <utility>
 
 #include "errorhandling.hpp"
 
@@ -21,15 +22,38 @@ SequentialDijkstra::SequentialDijkstra() {
 	/* nop */
 }
 
-template <typename V, typename W, typename G>
-static void execute_dijkstra0(Query& query, G& graph, ShortestPath* sp, bool join_results){
+// Max weight for which Dial's bucket queue is used instead of the radix heap
+static constexpr std::size_t DIAL_MAX_WEIGHT = 1024; // arbitrary value
+
+// Min average out-degree for which the indexed d-ary heap is used instead of the radix heap. On dense graphs
+// the lazy deletion of the radix heap pushes several duplicates per vertex.
+static constexpr std::size_t DARYHEAP_MIN_AVG_DEGREE = 64; // arbitrary value
+
+template <typename V, typename W, typename G, typename D, typename Q, typename... QueueArgs>
+static void execute_dijkstra0(Query& query, G& graph, ShortestPath* sp, bool join_results, QueueArgs&&... queue_args){
 	// initialize
-	SequentialDijkstraImpl<V, W, G> impl{graph, sp};
+	SequentialDijkstraImpl<V, W, G, D, Q> impl{graph, sp, std::forward<QueueArgs>(queue_args)...};
 
 	// fire the algorithm
 	impl(query, join_results);
 }
 
+// Select the queue according to the max weight, a nil max is either negative or greater than DIAL_MAX_WEIGHT
+template <typename W, typename D, typename G>
+static void execute_dijkstra1(Query& query, G& graph, ShortestPath* sp, bool join_results, W max_weight){
+	bool small_weights = max_weight >= 0 && static_cast<std::size_t>(max_weight) <= DIAL_MAX_WEIGHT;
+
+	if(small_weights && max_weight <= 1){ // 0-1 BFS
+		execute_dijkstra0<oid, W, G, D, Deque01<oid, D>>(query, graph, sp, join_results);
+	} else if (small_weights){ // Dial
+		execute_dijkstra0<oid, W, G, D, Dial<oid, D>>(query, graph, sp, join_results, static_cast<std::size_t>(max_weight));
+	} else if (graph.num_edges() >= DARYHEAP_MIN_AVG_DEGREE * graph.num_vertices()){ // dense graph
+		execute_dijkstra0<oid, W, G, D, IndexedDaryHeap<oid, D>>(query, graph, sp, join_results, graph.num_vertices());
+	} else {
+		execute_dijkstra0<oid, W, G, D, typename QueueDijkstra<oid, D>::type>(query, graph, sp, join_results);
+	}
+}
+
 template <typename W>
 static void execute_dijkstra(Query& query, ShortestPath* sp, bool join_results){
 	GraphDescriptorCompact* gdc = dynamic_cast<GraphDescriptorCompact*>(query.graph.get());
@@ -39,7 +63,15 @@ static void execute_dijkstra(Query& query, ShortestPath* sp, bool join_results){
 	std::shared_ptr<graph_t> graph_ptr = gdc->instantiate<W>(sp->weights);
 	graph_t& graph = *(graph_ptr.get());
 
-	execute_dijkstra0<oid, W, graph_t>(query, graph, sp, join_results);
+	W max_weight = 0;
+	BATmax(sp->weights.get(), &max_weight);
+
+	// store the distances in 32 bits when no shortest path can exceed them, to halve the memory traffic
+	if(distances_fit<int>(max_weight, graph.num_vertices())){
+		execute_dijkstra1<W, int>(query, graph, sp, join_results, max_weight);
+	} else {
+		execute_dijkstra1<W, typename DistanceDijkstra<W>::type>(query, graph, sp, join_results, max_weight);
+	}
 }
 
 template <>
@@ -51,7 +83,7 @@ void execute_dijkstra<void>(Query& query, ShortestPath* sp, bool join_results){
 	std::shared_ptr<graph_t> graph_ptr = gdc->instantiate();
 	graph_t& graph = *(graph_ptr.get());
 
-	execute_dijkstra0<oid, void, graph_t>(query, graph, sp, join_results);
+	execute_dijkstra0<oid, void, graph_t, DistanceDijkstra<void>::type, QueueDijkstra<oid, void>::type>(query, graph, sp, join_results);
 }
 
 void SequentialDijkstra::execute(Query& query, ShortestPath* sp, bool join_results){
@@ -73,11 +105,11 @@ void SequentialDijkstra::execute(Query& query, ShortestPath* sp, bool join_resul
 		case TYPE_lng:
 			execute_dijkstra<lng>(query, sp, join_results);
 			break;
-//#ifdef HAVE_HGE /* 128-bit integer, it seems a little bit excessive */
-//		case TYPE_hge:
-//			execute_dijkstra<hge>(query, sp, join_results);
-//			break;
-//#endif
+#ifdef HAVE_HGE /* 128-bit integer */
+		case TYPE_hge:
+			execute_dijkstra<hge>(query, sp, join_results);
+			break;
+#endif
 		case TYPE_oid:
 			execute_dijkstra<oid>(query, sp, join_results);
 			break;
@@ -8,40 +8,80 @@
 #ifndef ALGORITHM_SEQUENTIAL_DIJKSTRA_IMPL_HPP_
 #define ALGORITHM_SEQUENTIAL_DIJKSTRA_IMPL_HPP_
 
+#include <algorithm>
 #include <cstddef>
 #include <memory>
 #include <limits>
+#include <numeric>
 //#include <iostream> // debug only
 #include <type_traits>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "bat_handle.hpp"
+#include "compact_graph.hpp"
+#include "configuration.hpp"
+#include "distance.hpp"
 #include "joiner.hpp"
 #include "query.hpp"
 #include "queue.hpp"
+#include "tree_cache.hpp"
+#include "workspace.hpp"
 
 namespace gr8 { namespace algorithm { namespace sequential {
 
-template <typename V, typename W, typename Graph>
+template <typename V, typename W, typename Graph, typename Distance = typename DistanceDijkstra<W>::type, typename Queue = typename QueueDijkstra<V, typename std::conditional<std::is_void<W>::value, void, Distance>::type>::type>
 class SequentialDijkstraImpl {
 public:
 	using vertex_t = V;
-	using cost_t = typename Graph::cost_t;
+	using cost_t = Distance; // type of the distances, possibly different from the type of the weights
+	using result_t = typename CostDijkstra<W>::type; // type of the costs reported
 //	using query_t = Query<vertex_t, cost_t>;
 private:
-	using queue_t = typename QueueDijkstra<V, W>::type;
+	using queue_t = Queue;
+	using transpose_t = CompactGraphTranspose<V, W>;
+	using workspace_t = Workspace<V, cost_t>;
+	using tree_t = SearchTree<V, cost_t>;
 	static const cost_t INFINITY = std::numeric_limits<cost_t>::max();
+	static constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
 
+	// Cost of building the in-edges, in forward searches. The transpose visits all edges twice, while a search
+	// towards its destinations usually stops after a fraction of the graph
+	static constexpr std::size_t BACKWARD_TRANSPOSE_COST = 8; // arbitrary value
+
+	// result of a pair resolved with a backward search
+	struct BackwardResult {
+		cost_t cost; // INFINITY if not connected
+		std::size_t path_offset; // position of the path in backward_paths
+		std::size_t path_length;
+	};
+
+	std::unique_ptr<workspace_t> workspace; // owner of the arrays parents, distances, edge_ids and targets
 	vertex_t* parents;
 	cost_t* distances;
 	vertex_t* edge_ids;
 	const Graph& graph;
 	queue_t queue;
+	const cost_t bound; // max cost of the paths to explore, INFINITY if unbounded
 
 	// raw pointers, do not delete them
 	ShortestPath* shortest_path_cb; // current shortest path we are computing
 	std::unique_ptr<Joiner> joiner; // current joiner
 	std::vector<vertex_t> revpath; // to report a path
+	std::vector<bool>& targets; // bitmap of the destinations still to settle in ssmd
+	std::vector<std::size_t> backward_slot; // for each pair, its position in backward_results or NONE
+	std::vector<BackwardResult> backward_results;
+	std::vector<vertex_t> backward_paths; // edge ids, already in the forward order
+
+	// the pairs [j_first, j_last] sharing the source i_src, resolved by a single search
+	struct Run {
+		std::size_t i_src;
+		std::size_t j_first;
+		std::size_t j_last;
+	};
+
+	SearchTreeKey tree_key; // key of the search trees in the cache, graph_version is 0 if they are not cached
 
 	// Reset the state of the data structures and prepare for the execution using as
 	// source the node `src'
@@ -68,71 +108,87 @@ private:
 		queue.push(src);
 	}
 
-	// Dijkstra implementation
-	template <typename W_t = W>
-	typename std::enable_if<!std::is_void<W_t>::value>::type execute(vertex_t dst){
-		const auto& G = this->graph;
+	// Dijkstra implementation over the graph G, either the graph itself or its transpose. The search terminates
+	// when the queue is exhausted or as soon as the predicate `stop' returns true for the vertex that has just
+	// been settled
+	template <typename G_t, typename Stop, typename W_t = W>
+	typename std::enable_if<!std::is_void<W_t>::value>::type execute(const G_t& G, Stop&& stop){
 		vertex_t* __restrict P = this->parents;
 		cost_t* __restrict D = this->distances;
 		vertex_t* __restrict E = this->edge_ids;
 		queue_t& Q = this->queue;
+		const cost_t B = this->bound;
 
 		while(!Q.empty()){
 			auto root = Q.front();
-			if(root.dst == dst) break; // found
-
 			Q.pop(); // remove min from the queue
 			if(root.cost > D[root.dst]) continue; // we already considered this node, ignore
+			if(stop(root.dst)) break; // done
 
 			// relax the edges
-			for(const auto& e : G[root.dst]){
-				cost_t td = D[root.dst] + e.cost();
-				if(td < D[e.dest()]){
+			const cost_t d = D[root.dst];
+			G.for_each_improving(root.dst, D, d, B, [&](const typename G_t::edge_t& e){
+				cost_t td = d + e.cost();
+				if(td <= B && td < D[e.dest()]){
 					D[e.dest()] = td;
 					P[e.dest()] = root.dst;
 					E[e.dest()] = e.id();
 					Q.push({e.dest(), td});
 				}
-			}
+			});
 		}
 	}
 
 	// BFS implementation
-	template <typename W_t = W>
-	typename std::enable_if<std::is_void<W_t>::value>::type execute(vertex_t dst){
-		const auto& G = this->graph;
+	template <typename G_t, typename Stop, typename W_t = W>
+	typename std::enable_if<std::is_void<W_t>::value>::type execute(const G_t& G, Stop&& stop){
 		vertex_t* __restrict P = this->parents;
 		cost_t* __restrict D = this->distances;
 		vertex_t* __restrict E = this->edge_ids;
 		queue_t& Q = this->queue;
+		const cost_t B = this->bound;
 
 		while(!Q.empty()){
 			auto root = Q.front();
-			if(root == dst) break; // found
-
 			Q.pop(); // remove min from the queue
+			if(stop(root)) break; // done
 
 			// relax the edges
-			for(const auto& e : G[root]){
-				cost_t td = D[root] + e.cost();
-				if(td < D[e.dest()]){
+			const cost_t d = D[root];
+			G.for_each(root, D, [&](const typename G_t::edge_t& e){
+				cost_t td = d + e.cost();
+				if(td <= B && td < D[e.dest()]){
 					D[e.dest()] = td;
 					P[e.dest()] = root;
 					E[e.dest()] = e.id();
 					Q.push(e.dest());
 				}
-			}
+			});
 		}
 	}
 
+	// Has the pair j already been resolved by a backward search?
+	bool resolved(std::size_t j) const {
+		return !backward_slot.empty() && backward_slot[j] != NONE;
+	}
+
+	// Report a pair that is not connected
+	bool not_connected(){
+		// the pair has already been joined by a previous search with a looser bound
+		if(!joiner && shortest_path_cb) shortest_path_cb->append_nil();
+		return false;
+	}
+
 	/**
 	 * @return true if src[i] is connected to dst[j], false otherwise
 	 */
 	bool finish(Query& q, std::size_t i, std::size_t j){
+		if(resolved(j)) return finish_backward(i, j);
+
 		auto dst = q.qdst(j);
 
 		// did we reach the destination?
-		if(distances[dst] == INFINITY) return false; // no, we didn't
+		if(distances[dst] == INFINITY) return not_connected(); // no, we didn't
 
 		auto src = q.qsrc(i);
 
@@ -140,7 +196,7 @@ private:
 			joiner->join(i, j);
 
 		if(shortest_path_cb){
-			shortest_path_cb->append(distances[dst]);
+			shortest_path_cb->append(static_cast<result_t>(distances[dst]));
 
 			if(shortest_path_cb->compute_path()){
 				vertex_t current = dst;
@@ -157,10 +213,35 @@ private:
 		return true;
 	}
 
+	// Report the result of the pair j, computed by a backward search
+	bool finish_backward(std::size_t i, std::size_t j){
+		const BackwardResult& result = backward_results[backward_slot[j]];
+		if(result.cost == INFINITY) return not_connected();
+
+		if(joiner)
+			joiner->join(i, j);
+
+		if(shortest_path_cb){
+			shortest_path_cb->append(static_cast<result_t>(result.cost));
+
+			if(shortest_path_cb->compute_path()){
+				auto path_start = backward_paths.begin() + result.path_offset;
+				revpath.assign(path_start, path_start + result.path_length);
+				shortest_path_cb->append(revpath, false);
+				revpath.clear();
+			}
+		}
+
+		return true;
+	}
+
 	// Single source single destination
 	void sssd(Query& q, std::size_t i, std::size_t j){
-		init(q.qsrc(i));
-		execute(q.qdst(j));
+		if(!resolved(j)){
+			const vertex_t dst = q.qdst(j);
+			init(q.qsrc(i));
+			execute(graph, [dst](vertex_t v){ return v == dst; });
+		}
 		finish(q, i, j);
 	}
 
@@ -168,12 +249,36 @@ private:
 	std::size_t ssmd(Query& q, std::size_t i_src, std::size_t j_dst_first, std::size_t j_dst_last){
 		std::size_t count = 0; // keep track of how many tuples have been reached
 
-		init(q.qsrc(i_src));
+		// mark the set of destinations to reach
+		std::size_t num_targets = 0; // number of distinct targets not settled yet
 		for(std::size_t j = j_dst_first; j <= j_dst_last; j++){
-			if(distances[q.qdst(j)] == INFINITY){
-				execute(q.qdst(j));
+			if(resolved(j)) continue;
+			vertex_t dst = q.qdst(j);
+			if(!targets[dst]){
+				targets[dst] = true;
+				num_targets++;
 			}
+		}
+
+		// visit the graph until all targets have been settled
+		if(num_targets > 0){
+			init(q.qsrc(i_src));
+			execute(graph, [this, &num_targets](vertex_t v){
+				if(!targets[v]) return false;
+				targets[v] = false;
+				return --num_targets == 0;
+			});
+		}
+
+		// reset the targets that could not be reached
+		if(num_targets > 0){
+			for(std::size_t j = j_dst_first; j <= j_dst_last; j++){
+				targets[q.qdst(j)] = false;
+			}
+		}
 
+		// report the results
+		for(std::size_t j = j_dst_first; j <= j_dst_last; j++){
 			bool connected = finish(q, i_src, j);
 		    if(connected) count++;
 		}
@@ -181,20 +286,184 @@ private:
 		return count;
 	}
 
+	// Report the results of the run from the arrays of a search other than the main one
+	std::size_t report(Query& q, const Run& run, vertex_t* P, cost_t* D, vertex_t* E){
+		// finish(q, i, j) reads the arrays of the main search
+		parents = P;
+		distances = D;
+		edge_ids = E;
+		std::size_t count = 0;
+		for(std::size_t j = run.j_first; j <= run.j_last; j++){
+			if(finish(q, run.i_src, j)) count++;
+		}
+		parents = workspace->parents.get();
+		distances = workspace->distances.get();
+		edge_ids = workspace->edge_ids.get();
+
+		return count;
+	}
+
+	// Resolve each run from the complete search tree of its source, either retrieved from the cache or computed
+	// and then stored in the cache
+	void execute_runs_cached(Query& q, const std::vector<Run>& runs){
+		SearchTreeCache& cache = SearchTreeCache::instance();
+		for(const Run& run : runs){
+			SearchTreeKey key = tree_key;
+			key.source = q.qsrc(run.i_src);
+			std::shared_ptr<const tree_t> tree = cache.template get<tree_t>(key);
+			if(!tree){
+				init(key.source);
+				execute(graph, [](vertex_t){ return false; });
+				tree.reset(new tree_t(graph.size(), parents, distances, edge_ids));
+				cache.put(key, tree, configuration().tree_cache_memory());
+			}
+			report(q, run, tree->parents.get(), tree->distances.get(), tree->edge_ids.get());
+		}
+	}
+
+	// Key of the search trees of the query in the cache. They are cached only for unbounded searches over the
+	// whole graph, cached by prepare_graph. The weights are identified by their content, as permuted for the graph.
+	SearchTreeKey make_tree_key(Query& q) const {
+		SearchTreeKey key;
+		GraphDescriptorCompact* gdc = dynamic_cast<GraphDescriptorCompact*>(q.graph.get());
+		if(configuration().tree_cache_memory() == 0 || gdc == nullptr || gdc->version == 0 || bound != INFINITY) return key;
+		if(shortest_path_cb != nullptr && !shortest_path_cb->bfs()){
+			const BatHandle& weights = shortest_path_cb->weights;
+			key.weights_type = weights.get()->ttype;
+			key.weights_hash = content_hash(weights, 0, weights.size());
+		}
+		key.graph_version = gdc->version;
+		return key;
+	}
+
+	// Resolve the given runs, either one after the other or from the cached search trees
+	void execute_runs(Query& q, const std::vector<Run>& runs){
+		if(tree_key.graph_version != 0){
+			execute_runs_cached(q, runs);
+		} else {
+			for(const Run& run : runs){
+				if(run.j_first == run.j_last){
+					sssd(q, run.i_src, run.j_first);
+				} else {
+					ssmd(q, run.i_src, run.j_first, run.j_last);
+				}
+			}
+		}
+	}
+
+	// Resolve the pairs sharing the same destination with a single search from the destination over the
+	// in-edges, when the destination occurs in more pairs than any of their runs of equal sources
+	void filter_backward(Query& q){
+		const OidColumn src = q.query_src.oids();
+		const OidColumn dst = q.query_dst.oids();
+		const std::size_t size = q.query_src.size();
+
+		// each backward search saves at most the repetitions of its destination, skip when all of them together
+		// cannot pay for the in-edges, as in the common case of distinct destinations
+		if(size <= BACKWARD_TRANSPOSE_COST +1) return;
+		std::unordered_set<oid> distinct_dst;
+		distinct_dst.reserve(size);
+		for(std::size_t j = 0; j < size; j++){ distinct_dst.insert(dst[j]); }
+		if(size - distinct_dst.size() <= BACKWARD_TRANSPOSE_COST) return;
+
+		// length of the run of equal sources for each pair, i.e. the number of pairs a forward search resolves
+		std::vector<std::size_t> run_length(size);
+		for(std::size_t i = 0; i < size; ){
+			std::size_t n = 1;
+			while(i + n < size && src[i + n] == src[i]) n++;
+			std::fill(run_length.begin() + i, run_length.begin() + i + n, n);
+			i += n;
+		}
+
+		// group the pairs by destination
+		std::vector<std::size_t> order(size);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [dst](std::size_t a, std::size_t b){ return dst[a] < dst[b]; });
+
+		// pick the groups to search backwards
+		std::vector<std::pair<std::size_t, std::size_t>> groups; // [start, end) in `order'
+		backward_slot.assign(size, NONE);
+		for(std::size_t start = 0; start < size; ){
+			std::size_t end = start + 1;
+			std::size_t max_run = run_length[order[start]];
+			while(end < size && dst[order[end]] == dst[order[start]]){
+				max_run = std::max(max_run, run_length[order[end]]);
+				end++;
+			}
+			if(end - start > 1 && end - start > max_run){
+				groups.emplace_back(start, end);
+				for(std::size_t k = start; k < end; k++){ backward_slot[order[k]] = 0; }
+			}
+			start = end;
+		}
+
+		// the forward searches saved, net of the backward searches, should exceed the cost of building the in-edges
+		std::size_t runs_saved = 0;
+		for(std::size_t i = 0; i < size; i += run_length[i]){
+			bool covered = true;
+			for(std::size_t k = i; covered && k < i + run_length[i]; k++){ covered = resolved(k); }
+			if(covered) runs_saved++;
+		}
+		if(runs_saved <= groups.size() + BACKWARD_TRANSPOSE_COST){
+			backward_slot.clear();
+			return;
+		}
+
+		// search backwards from each destination
+		transpose_t transpose{graph};
+		for(const auto& g : groups){
+			std::size_t num_targets = 0;
+			for(std::size_t k = g.first; k < g.second; k++){
+				vertex_t s = src[order[k]];
+				if(!targets[s]){
+					targets[s] = true;
+					num_targets++;
+				}
+			}
+
+			const vertex_t root = dst[order[g.first]];
+			init(root);
+			execute(transpose.get(), [this, &num_targets](vertex_t v){
+				if(!targets[v]) return false;
+				targets[v] = false;
+				return --num_targets == 0;
+			});
+
+			for(std::size_t k = g.first; k < g.second; k++){
+				const std::size_t j = order[k];
+				vertex_t current = src[j];
+				targets[current] = false;
+
+				backward_slot[j] = backward_results.size();
+				BackwardResult result { distances[current], backward_paths.size(), 0 };
+				if(result.cost != INFINITY && shortest_path_cb && shortest_path_cb->compute_path()){
+					// in the transpose, parents point towards the destination
+					while(current != root){
+						backward_paths.push_back(edge_ids[current]);
+						current = parents[current];
+					}
+					result.path_length = backward_paths.size() - result.path_offset;
+				}
+				backward_results.push_back(result);
+			}
+		}
+	}
+
 	void filter(Query& q){
 		assert(q.query_src.size() == q.query_dst.size() && q.query_dst.size()  == q.candidates_left.size());
 //		oid* __restrict candidates = q.candidates_left.array<oid>();
-		vertex_t* __restrict src = q.query_src.array<vertex_t>();
+		const OidColumn src = q.query_src.oids();
 //		vertex_t* dst = q.query_dst.array<oid>();
 		const std::size_t size = q.query_src.size();
 
+		if(tree_key.graph_version == 0){ // otherwise resolve the pairs from the cached search trees
+			filter_backward(q);
+		}
 
-		auto flush = [this, &q](std::size_t i, std::size_t n){
-			if(n == 1){
-				sssd(q, i, i);
-			} else {
-				ssmd(q, i, i, i+n -1);
-			}
+
+		std::vector<Run> runs;
+		auto flush = [&runs](std::size_t i, std::size_t n){
+			runs.push_back(Run{i, i, i+n -1});
 		};
 
 		std::size_t contiguous_sources = 1;
@@ -208,25 +477,42 @@ private:
 		}
 
 		flush(size - contiguous_sources, contiguous_sources);
+		execute_runs(q, runs);
+
+		backward_slot.clear();
+		backward_results.clear();
+		backward_paths.clear();
+	}
+
+	// Convert the bound requested by the user into the cost type
+	static cost_t get_bound(ShortestPath* sp){
+		if(sp == nullptr || !sp->bounded()) return INFINITY;
+		lng value = sp->bound(); // >= 0
+		if(static_cast<unsigned long long>(value) >= static_cast<unsigned long long>(INFINITY)) return INFINITY;
+		return static_cast<cost_t>(value);
 	}
 
 	void join(Query &q){
+		std::vector<Run> runs;
 		for(std::size_t i = 0; i < q.query_src.size(); i++){
-			ssmd(q, i, 0, q.query_dst.size() -1);
+			runs.push_back(Run{i, 0, q.query_dst.size() -1});
 		}
+		execute_runs(q, runs);
 	}
 
 public:
-	SequentialDijkstraImpl(const Graph& graph, ShortestPath* sp) :
-		parents(new vertex_t[graph.size()]), distances(new cost_t[graph.size()]), edge_ids(new vertex_t[graph.size()]),
-		graph(graph), queue(), shortest_path_cb(sp), joiner(nullptr) {
+	// The additional arguments are forwarded to the ctor of the queue
+	template <typename... QueueArgs>
+	SequentialDijkstraImpl(const Graph& graph, ShortestPath* sp, QueueArgs&&... queue_args) :
+		workspace(workspace_t::acquire(graph.size())),
+		parents(workspace->parents.get()), distances(workspace->distances.get()), edge_ids(workspace->edge_ids.get()),
+		graph(graph), queue(std::forward<QueueArgs>(queue_args)...), bound(get_bound(sp)), shortest_path_cb(sp), joiner(nullptr), targets(workspace->targets) {
 
 	}
 
 	~SequentialDijkstraImpl(){
-		delete[] parents;
-		delete[] distances;
-		delete[] edge_ids;
+		const std::size_t budget = configuration().workspace_cache_memory();
+		workspace_t::release(std::move(workspace), budget);
 	}
 
 	// Connect only
@@ -235,6 +521,7 @@ public:
 
 		try {
 			if(join_results) joiner.reset(new Joiner(query));
+			tree_key = make_tree_key(query);
 
 			if(query.is_filter_semantics()){
 				filter(query);
@@ -0,0 +1,56 @@
+#ifndef ALGORITHM_SEQUENTIAL_DIJKSTRA_DISTANCE_HPP_
+#define ALGORITHM_SEQUENTIAL_DIJKSTRA_DISTANCE_HPP_
+
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+#include "monetdb_config.hpp"
+
+namespace gr8 { namespace algorithm { namespace sequential {
+
+// Type reported in the output column of the path costs, for edges with weights W.
+// Keep in sync with ShortestPath::cost_type()
+template<typename W, typename _enable = void>
+struct CostDijkstra {
+	using type = W;
+};
+
+// BFS, number of hops
+template<>
+struct CostDijkstra<void> {
+	using type = lng;
+};
+
+// Narrow signed integers are accumulated as lng, like sum(), as paths easily exceed their domain
+template<typename W>
+struct CostDijkstra<W, typename std::enable_if<std::numeric_limits<W>::is_integer && std::numeric_limits<W>::is_signed && (sizeof(W) < sizeof(lng))>::type> {
+	using type = lng;
+};
+
+// Type used to store the distances during the search, when the max cost of any shortest path is not known
+template<typename W>
+struct DistanceDijkstra {
+	using type = typename CostDijkstra<W>::type;
+};
+
+// BFS, keep the distances as wide as the vertex ids
+template<>
+struct DistanceDijkstra<void> {
+	using type = std::size_t;
+};
+
+// Can the distances be stored in the (narrower) type D? A shortest path visits each vertex at most once, so
+// its cost is bounded by max_weight * (num_vertices -1). The max value of D is reserved for infinity.
+template<typename D, typename W>
+bool distances_fit(W max_weight, std::size_t num_vertices){
+	if(max_weight < 0) return false; // nil or negative weights
+	if(num_vertices <= 1) return true;
+	using limit_t = typename std::common_type<W, D>::type;
+	const limit_t limit = (static_cast<limit_t>(std::numeric_limits<D>::max()) -1) / static_cast<limit_t>(num_vertices -1);
+	return static_cast<limit_t>(max_weight) <= limit;
+}
+
+}}} // namespace gr8::algorithm::sequential
+
+#endif /* ALGORITHM_SEQUENTIAL_DIJKSTRA_DISTANCE_HPP_ */
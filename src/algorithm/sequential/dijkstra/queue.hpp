@@ -8,6 +8,12 @@
 #ifndef ALGORITHM_SEQUENTIAL_DIJKSTRA_QUEUE_HPP_
 #define ALGORITHM_SEQUENTIAL_DIJKSTRA_QUEUE_HPP_
 
+#include <limits>
+#include <type_traits>
+
+#include "daryheap.hpp"
+#include "deque01.hpp"
+#include "dial.hpp"
 #include "fifo.hpp"
 #include "radixheap.hpp"
 
@@ -25,20 +31,12 @@ struct QueueDijkstra<vertex_t, void>{
     using type = FIFO<vertex_t>;
 };
 
-// Radix heap
+// Radix heap. Rely on numeric_limits rather than is_integral, the latter excludes __int128 in strict ISO mode
 template<typename vertex_t, typename distance_t>
-struct QueueDijkstra<vertex_t, distance_t, typename std::enable_if<std::is_integral<distance_t>::value>::type >{
+struct QueueDijkstra<vertex_t, distance_t, typename std::enable_if<std::numeric_limits<distance_t>::is_integer>::type >{
 	using type = RadixHeap<vertex_t, distance_t>;
 };
 
-// HGE, need a proper fix
-//#if defined(__SIZEOF_INT128__)
-//template<typename vertex_t>
-//struct QueueDijkstra<vertex_t, __int128>{
-//	using type = RadixHeap<vertex_t, __int128>;
-//};
-//#endif
-
 }}} // namespace gr8::algorithm::sequential
 
 #endif /* ALGORITHM_SEQUENTIAL_DIJKSTRA_QUEUE_HPP_ */
@@ -4,6 +4,7 @@
 #include <cassert>
 #include <cstring>
 #include <limits>
+#include <vector>
 
 namespace gr8 { namespace algorithm { namespace sequential {
 
@@ -24,6 +25,19 @@ namespace radixheap_internal {
 		return 64 - __builtin_clzll(a ^ b);
 	}
 
+#if defined(__SIZEOF_INT128__)
+	template<typename T>
+	typename std::enable_if<sizeof(T) == 16, int>::type MSD(T a, T b){
+		if(a == b) return 0; // edge case
+		unsigned __int128 x = static_cast<unsigned __int128>(a) ^ static_cast<unsigned __int128>(b);
+		uint64_t high = static_cast<uint64_t>(x >> 64);
+		if(high != 0)
+			return 128 - __builtin_clzll(high);
+		else
+			return 64 - __builtin_clzll(static_cast<uint64_t>(x));
+	}
+#endif
+
 	template<typename T>
 	typename std::enable_if<sizeof(T) < 4, int>::type MSD(T a, T b){
 		return MSD((uint32_t) a, (uint32_t) b);
@@ -43,6 +57,55 @@ namespace radixheap_internal {
 	}
 #endif
 
+	// Thread local pool of the bucket arrays. The arrays survive both clear() and the instances of the
+	// radix heap in the same thread, keeping the capacity they grew to.
+	template<typename pair, std::size_t bsize>
+	class BucketPool {
+		struct bucket_t { pair* base; std::size_t capacity; };
+		const static std::size_t max_pooled = 4; // max number of free arrays kept for each bucket index
+		std::vector<bucket_t> free_buckets[bsize];
+
+		BucketPool() { }
+		BucketPool(const BucketPool&) = delete;
+		BucketPool& operator=(const BucketPool&) = delete;
+
+	public:
+		~BucketPool(){
+			for(std::size_t i = 0; i < bsize; i++){
+				for(auto& b : free_buckets[i]){ delete[] b.base; }
+			}
+		}
+
+		// retrieve an array for the bucket `index', with at least capacity `capmin'
+		pair* acquire(std::size_t index, std::size_t capmin, std::size_t& out_capacity){
+			auto& pool = free_buckets[index];
+			if(pool.empty()){
+				out_capacity = capmin;
+				return new pair[capmin];
+			} else {
+				bucket_t b = pool.back();
+				pool.pop_back();
+				out_capacity = b.capacity;
+				return b.base;
+			}
+		}
+
+		// give back the array of the bucket `index'
+		void release(std::size_t index, pair* base, std::size_t capacity){
+			auto& pool = free_buckets[index];
+			if(pool.size() < max_pooled){
+				pool.push_back(bucket_t{base, capacity});
+			} else {
+				delete[] base;
+			}
+		}
+
+		static BucketPool& instance(){
+			static thread_local BucketPool pool;
+			return pool;
+		}
+	};
+
 } /* namespace internal */
 
 template<typename vertex_t, typename distance_t>
@@ -51,11 +114,14 @@ public:
 	struct pair { vertex_t dst; distance_t cost; };
 private:
 	const static std::size_t bsize = std::numeric_limits<distance_t>::digits + 1;
-	const static std::size_t capmin = 1024; // arbitrary value
+	const static std::size_t capmin = 16; // arbitrary value
+	const static std::size_t shrink_factor = 4; // shrink a bucket when its capacity is this many times its peak
 	const static distance_t inf = std::numeric_limits<distance_t>::max(); // infinity
+	using pool_t = radixheap_internal::BucketPool<pair, bsize>;
 
 	std::size_t capacity[bsize];
 	std::size_t size[bsize];
+	std::size_t peak[bsize]; // recent max size of each bucket
 	distance_t bmin[bsize];
 	pair* buckets[bsize];
 	distance_t lastmin;
@@ -103,32 +169,46 @@ private:
 			push0(bucket[j]);
 		}
 
-		// update the control variables
+		// update the control variables, the bucket keeps its capacity as it is likely to be filled again
+		if(size[imin] > peak[imin]) peak[imin] = size[imin];
 		bmin[imin] = inf;
 		size[imin] = 0;
-		if(capacity[imin] > capmin){ // shrink the bucket
-			delete[] buckets[imin];
-			buckets[imin] = new pair[capmin];
-			capacity[imin] = capmin;
-		}
 
 		assert(size[0] > 0);
+		if(size[0] > peak[0]) peak[0] = size[0];
+	}
+
+	// shrink the buckets whose capacity is well above their recent peak. The peaks decay by half at each
+	// clear, so a single large search does not pin its memory for all the following ones.
+	void shrink(){
+		for(std::size_t i = 0; i < bsize; i++){
+			std::size_t target = capmin;
+			while(target < peak[i]) target *= 2;
+			if(capacity[i] > shrink_factor * target){
+				delete[] buckets[i];
+				buckets[i] = new pair[target];
+				capacity[i] = target;
+			}
+			peak[i] /= 2;
+		}
 	}
 
 public:
 	RadixHeap() : lastmin(0), hsize(0) {
-		// initialise the buckets
+		// initialise the buckets, reusing the arrays from the previous instances in the same thread
+		pool_t& pool = pool_t::instance();
 		for(std::size_t i = 0; i < bsize; i++){
-			capacity[i] = 16; // arbitrary value
 			size[i] = 0;
+			peak[i] = 0;
 			bmin[i] = inf; // infinity
-			buckets[i] = new pair[capacity[i]]();
+			buckets[i] = pool.acquire(i, capmin, capacity[i]);
 		}
 	}
 
 	~RadixHeap(){
+		pool_t& pool = pool_t::instance();
 		for(std::size_t i = 0; i < bsize; i++){
-			delete[] buckets[i];
+			pool.release(i, buckets[i], capacity[i]);
 		}
 	}
 
@@ -154,17 +234,15 @@ public:
 
 	void clear() {
 		lastmin = 0;
-		if(empty()) return;
-		hsize = 0;
-		for(std::size_t i = 0; i < bsize; i++){
-			size[i] = 0;
-			bmin[i] = inf; // infinity
-			if(capacity[i] > capmin){
-				delete[] buckets[i];
-				buckets[i] = new pair[capmin];
-				capacity[i] = capmin;
+		if(!empty()){
+			hsize = 0;
+			for(std::size_t i = 0; i < bsize; i++){
+				if(size[i] > peak[i]) peak[i] = size[i];
+				size[i] = 0;
+				bmin[i] = inf; // infinity
 			}
 		}
+		shrink();
 	}
 
 };
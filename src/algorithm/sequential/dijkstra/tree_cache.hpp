@@ -0,0 +1,139 @@
+#ifndef ALGORITHM_SEQUENTIAL_DIJKSTRA_TREE_CACHE_HPP_
+#define ALGORITHM_SEQUENTIAL_DIJKSTRA_TREE_CACHE_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "monetdb_config.hpp"
+
+namespace gr8 { namespace algorithm { namespace sequential {
+
+/**
+ * Identifies a complete search tree: the version of the compact graph, the weights and the source. The weights
+ * are identified by the hash of their content, an update of their values in place changes the key. A graph
+ * version of 0 means that the search tree cannot be cached.
+ */
+struct SearchTreeKey {
+	uint64_t graph_version = 0;
+	int weights_type = 0; // 0 for a BFS
+	uint64_t weights_hash = 0;
+	oid source = 0;
+
+	bool operator==(const SearchTreeKey& other) const {
+		return graph_version == other.graph_version && weights_type == other.weights_type &&
+				weights_hash == other.weights_hash && source == other.source;
+	}
+
+	struct hash {
+		std::size_t operator()(const SearchTreeKey& key) const {
+			std::size_t h = std::hash<uint64_t>()(key.graph_version);
+			h = h * 31 + std::hash<int>()(key.weights_type);
+			h = h * 31 + std::hash<uint64_t>()(key.weights_hash);
+			return h * 31 + std::hash<oid>()(key.source);
+		}
+	};
+};
+
+// Type erased search tree
+class SearchTreeBase {
+public:
+	virtual ~SearchTreeBase() { }
+	virtual std::size_t memory_footprint() const = 0;
+};
+
+// The arrays of a search run to completion from a single source
+template<typename vertex_t, typename cost_t>
+class SearchTree : public SearchTreeBase {
+	const std::size_t size;
+
+	SearchTree(const SearchTree&) = delete;
+	SearchTree& operator=(const SearchTree&) = delete;
+
+public:
+	std::unique_ptr<vertex_t[]> parents;
+	std::unique_ptr<cost_t[]> distances;
+	std::unique_ptr<vertex_t[]> edge_ids;
+
+	// Copy the arrays of a search over `size' vertices
+	SearchTree(std::size_t size, const vertex_t* P, const cost_t* D, const vertex_t* E) : size(size),
+		parents(new vertex_t[size]), distances(new cost_t[size]), edge_ids(new vertex_t[size]) {
+		std::copy(P, P + size, parents.get());
+		std::copy(D, D + size, distances.get());
+		std::copy(E, E + size, edge_ids.get());
+	}
+
+	std::size_t memory_footprint() const {
+		return size * (2 * sizeof(vertex_t) + sizeof(cost_t));
+	}
+};
+
+/**
+ * Search trees shared by the queries on the same graph, weights and sources, evicted in LRU order to stay within
+ * the memory budget. A new version of the graph or new weights change the key, the trees of the previous ones
+ * are no longer retrieved and eventually evicted.
+ */
+class SearchTreeCache {
+	struct Entry {
+		SearchTreeKey key;
+		std::shared_ptr<const SearchTreeBase> tree;
+	};
+	using list_t = std::list<Entry>;
+
+	std::mutex mutex;
+	list_t entries; // the most recently used first
+	std::unordered_map<SearchTreeKey, list_t::iterator, SearchTreeKey::hash> index;
+	std::size_t memory_used = 0; // bytes
+
+	SearchTreeCache() { }
+
+public:
+	// Retrieve the search tree for the given key, nullptr if not present
+	template<typename T>
+	std::shared_ptr<const T> get(const SearchTreeKey& key){
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = index.find(key);
+		if(it == index.end()) return nullptr;
+		entries.splice(entries.begin(), entries, it->second);
+		return std::dynamic_pointer_cast<const T>(it->second->tree); // nullptr if computed with another distance type
+	}
+
+	// Store the search tree, evicting the least recently used ones to stay within `max_memory' bytes
+	void put(const SearchTreeKey& key, std::shared_ptr<const SearchTreeBase> tree, std::size_t max_memory){
+		std::lock_guard<std::mutex> lock(mutex);
+		const std::size_t footprint = tree->memory_footprint();
+		if(footprint > max_memory) return;
+
+		auto it = index.find(key);
+		if(it != index.end()){ // replace
+			memory_used -= it->second->tree->memory_footprint();
+			entries.erase(it->second);
+			index.erase(it);
+		}
+		while(memory_used + footprint > max_memory){
+			memory_used -= entries.back().tree->memory_footprint();
+			index.erase(entries.back().key);
+			entries.pop_back();
+		}
+
+		entries.push_front(Entry{key, std::move(tree)});
+		index[key] = entries.begin();
+		memory_used += footprint;
+	}
+
+	// Leaked on purpose, to avoid destruction-order issues at exit
+	static SearchTreeCache& instance(){
+		static SearchTreeCache* instance = new SearchTreeCache();
+		return *instance;
+	}
+};
+
+}}} // namespace gr8::algorithm::sequential
+
+#endif /* ALGORITHM_SEQUENTIAL_DIJKSTRA_TREE_CACHE_HPP_ */
@@ -0,0 +1,87 @@
+#ifndef ALGORITHM_SEQUENTIAL_DIJKSTRA_WORKSPACE_HPP_
+#define ALGORITHM_SEQUENTIAL_DIJKSTRA_WORKSPACE_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace gr8 { namespace algorithm { namespace sequential {
+
+// Memory, in bytes, retained by the cached workspaces of the current thread, of all types
+inline std::size_t& workspace_cached_bytes(){
+	static thread_local std::size_t instance = 0;
+	return instance;
+}
+
+/**
+ * The vertex arrays of a search. The last released workspace is cached per thread and per types, so that
+ * consecutive spfw calls on graphs of similar size do not allocate (and fault) the arrays again. The memory
+ * retained by each thread is bounded by a budget, set through GRAPH_WORKSPACE_CACHE_MB.
+ */
+template<typename vertex_t, typename cost_t>
+class Workspace {
+	// Do not reuse a cached workspace larger than this factor w.r.t. the requested size
+	static constexpr std::size_t MAX_WASTE_FACTOR = 4; // arbitrary value
+
+	const std::size_t _capacity;
+
+	Workspace(const Workspace&) = delete;
+	Workspace& operator=(const Workspace&) = delete;
+
+	static std::unique_ptr<Workspace>& cached(){
+		static thread_local std::unique_ptr<Workspace> instance;
+		return instance;
+	}
+
+public:
+	std::unique_ptr<vertex_t[]> parents;
+	std::unique_ptr<cost_t[]> distances;
+	std::unique_ptr<vertex_t[]> edge_ids;
+	std::vector<bool> targets; // all false when not in use
+
+	Workspace(std::size_t capacity) : _capacity(capacity),
+		parents(new vertex_t[capacity]), distances(new cost_t[capacity]), edge_ids(new vertex_t[capacity]) { }
+
+	std::size_t capacity() const {
+		return _capacity;
+	}
+
+	// Memory held by the arrays, in bytes
+	std::size_t footprint() const {
+		return _capacity * (2 * sizeof(vertex_t) + sizeof(cost_t)) + targets.capacity() / 8;
+	}
+
+	// Retrieve a workspace for a graph with `num_vertices' vertices, from the cache of the current thread if possible
+	static std::unique_ptr<Workspace> acquire(std::size_t num_vertices){
+		std::unique_ptr<Workspace> ws = std::move(cached());
+		if(ws){
+			workspace_cached_bytes() -= ws->footprint();
+		}
+		if(!ws || ws->capacity() < num_vertices || ws->capacity() > MAX_WASTE_FACTOR * num_vertices){
+			ws.reset(new Workspace(num_vertices));
+		}
+		ws->targets.assign(num_vertices, false);
+		return ws;
+	}
+
+	// Give back the workspace to the cache of the current thread, replacing the previous one. The workspace is
+	// freed if it does not fit in `budget' bytes, together with the workspaces cached for the other types.
+	static void release(std::unique_ptr<Workspace> ws, std::size_t budget){
+		auto& cache = cached();
+		auto& bytes = workspace_cached_bytes();
+		if(cache){
+			bytes -= cache->footprint();
+			cache.reset();
+		}
+		const std::size_t footprint = ws->footprint();
+		if(bytes + footprint <= budget){
+			bytes += footprint;
+			cache = std::move(ws);
+		}
+	}
+};
+
+}}} // namespace gr8::algorithm::sequential
+
+#endif /* ALGORITHM_SEQUENTIAL_DIJKSTRA_WORKSPACE_HPP_ */
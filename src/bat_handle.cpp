@@ -7,8 +7,10 @@
 
 #include "bat_handle.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 
 #include "errorhandling.hpp"
@@ -117,3 +119,51 @@ bat BatHandle::release(bool value){
 		return -1;
 	}
 }
+
+/******************************************************************************
+ *                                                                            *
+ *  Content hash                                                              *
+ *                                                                            *
+ ******************************************************************************/
+
+static inline uint64_t hash_mix(uint64_t h, uint64_t value){
+	h = (h ^ value) * 0x9E3779B97F4A7C15ull;
+	return h ^ (h >> 29);
+}
+
+// The values are hashed in four independent lanes, to keep the multiplications in flight
+uint64_t gr8::content_hash(const BatHandle& column, size_t begin, size_t end){
+	BAT* b = column.get();
+	uint64_t lanes[4] = { 0x243F6A8885A308D3ull, 0x13198A2E03707344ull, 0xA4093822299F31D0ull, 0x082EFA98EC4E6C89ull };
+	size_t length; // in bytes
+
+	if(b->T.type == TYPE_void){
+		const oid seqbase = b->T.seq;
+		for(size_t i = begin; i < end; i++){
+			lanes[(i - begin) % 4] = hash_mix(lanes[(i - begin) % 4], seqbase + i);
+		}
+		length = (end - begin) * sizeof(oid);
+	} else {
+		const size_t width = ATOMsize(b->T.type);
+		const char* data = (const char*) Tloc(b, 0) + begin * width;
+		length = (end - begin) * width;
+		size_t i = 0;
+		for( ; i + 32 <= length; i += 32){
+			uint64_t words[4];
+			memcpy(words, data + i, sizeof(words));
+			lanes[0] = hash_mix(lanes[0], words[0]);
+			lanes[1] = hash_mix(lanes[1], words[1]);
+			lanes[2] = hash_mix(lanes[2], words[2]);
+			lanes[3] = hash_mix(lanes[3], words[3]);
+		}
+		for( ; i < length; i += 8){ // tail
+			uint64_t word = 0;
+			memcpy(&word, data + i, std::min<size_t>(8, length - i));
+			lanes[(i / 8) % 4] = hash_mix(lanes[(i / 8) % 4], word);
+		}
+	}
+
+	uint64_t h = length;
+	for(uint64_t lane : lanes){ h = hash_mix(h, lane); }
+	return h;
+}
@@ -8,6 +8,7 @@
 #ifndef BAT_HANDLE_HPP_
 #define BAT_HANDLE_HPP_
 
+#include <cstdint>
 #include <memory>
 #include <stdexcept>
 
@@ -16,6 +17,25 @@
 
 namespace gr8  {
 
+// Read-only view over the values of a column of oids, either materialised or dense (TYPE_void). A dense column
+// is a sequence [seqbase, seqbase +1, ...] with no heap, its values are computed rather than materialised.
+class OidColumn {
+	const oid* base; // nullptr if dense
+	oid seqbase;
+
+public:
+	OidColumn(const oid* base, oid seqbase) : base(base), seqbase(seqbase) { }
+
+	bool dense() const { return base == nullptr; }
+
+	// the underlying array, nullptr if the column is dense
+	const oid* data() const { return base; }
+
+	oid operator[](std::size_t i) const {
+		return base != nullptr ? base[i] : seqbase + i;
+	}
+};
+
 // Shared pointer to a MonetDB BAT
 class BatHandle {
 private:
@@ -105,6 +125,7 @@ public:
 	template<typename T>
 	T at(size_t i) const{
 		CHECK_EXCEPTION(Exception, !empty(), "The BAT is empty");
+		if(dense()) return static_cast<T>(get()->T.seq + i);
 		return array<T>()[i];
 	}
 	template<typename T>
@@ -117,11 +138,25 @@ public:
 		return at<T>(size() -1);
 	}
 
+	// Is the underlying BAT a dense sequence of oids, without a heap?
+	bool dense() const {
+		return get()->T.type == TYPE_void;
+	}
+
+	// Access the values of a column of oids, without materialising a dense column
+	OidColumn oids() const {
+		BAT* b = get();
+		return b->T.type == TYPE_void ? OidColumn{ nullptr, b->T.seq } : OidColumn{ reinterpret_cast<const oid*>(b->T.heap.base), 0 };
+	}
+
 	int type() const {
 		return ATOMtype(get()->T.type);
 	}
 };
 
+// Hash of the values [begin, end) of a column of fixed size atoms. A dense column has the same hash as the column
+// of oids with the same values.
+uint64_t content_hash(const BatHandle& column, std::size_t begin, std::size_t end);
 
 }
 
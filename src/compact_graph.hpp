@@ -1,9 +1,15 @@
 #ifndef COMPACT_GRAPH_HPP_
 #define COMPACT_GRAPH_HPP_
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef> // std::size_t
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <type_traits>
+
+#include "compact_graph_simd.hpp"
 
 namespace gr8 {
 
@@ -57,11 +63,57 @@ namespace gr8 {
 		vertex_t* __restrict vertices;
 		vertex_t* __restrict edges;
 		cost_t* __restrict weights;
-		vertex_t* __restrict edge_ids;
+		vertex_t* __restrict edge_ids; // nullptr if the ids are the dense sequence [edge_ids_seqbase, edge_ids_seqbase +1, ...]
+		vertex_t edge_ids_seqbase;
+		const uint64_t* __restrict mask; // bitmap over the positions of the edges, nullptr if all edges are enabled
+		std::size_t delta_count; // edges appended or updated after the base, sorted by source, at the positions [num_base_edges(), num_edges())
+		vertex_t* __restrict delta_src;
+		vertex_t* __restrict delta_dst;
 
 		CompactGraph(const CompactGraph&) = delete;
 		CompactGraph& operator=(CompactGraph&) = delete;
 
+		template<typename type = W>
+		typename std::enable_if<!std::is_void<type>::value, edge_t>::type make_edge(vertex_t dest, std::size_t i) const noexcept {
+			return edge_t{dest, weights[i], edge_id(i)};
+		}
+
+		template<typename type = W>
+		typename std::enable_if<std::is_void<type>::value, edge_t>::type make_edge(vertex_t dest, std::size_t i) const noexcept {
+			return edge_t{dest, edge_id(i)};
+		}
+
+		// Original id of the edge at position i
+		vertex_t edge_id(std::size_t i) const noexcept {
+			return edge_ids != nullptr ? edge_ids[i] : edge_ids_seqbase + i;
+		}
+
+		// Is the edge at position i enabled?
+		bool enabled(std::size_t i) const noexcept {
+			return mask == nullptr || ((mask[i / 64] >> (i % 64)) & 1);
+		}
+
+		// Invoke fn(edge) for each enabled edge of `vertex_id' in the delta
+		template<typename Fn>
+		void for_each_delta(vertex_t vertex_id, Fn&& fn) const {
+			if(delta_count == 0) return;
+			const std::size_t base = num_base_edges();
+			const std::size_t begin = std::lower_bound(delta_src, delta_src + delta_count, vertex_id) - delta_src;
+			for(std::size_t i = begin; i < delta_count && delta_src[i] == vertex_id; i++){
+				if(enabled(base + i)) fn(make_edge(delta_dst[i], base + i));
+			}
+		}
+
+		// Hint the cpu to load the entries of `lookup' for the destinations of the edges in [begin, end)
+		template<typename T>
+		void prefetch(const T* lookup, std::size_t begin, std::size_t end) const noexcept {
+#if defined(__GNUG__) or defined(__clang__) // gcc & clang only
+			for(std::size_t i = begin; i < end; i++){
+				__builtin_prefetch(lookup + edges[i], 0 /* read */, 3 /* keep in all cache levels */);
+			}
+#endif
+		}
+
 	public:
 		template<typename type = W, bool dummy = true>
 		class iterator_fwd{
@@ -147,8 +199,12 @@ namespace gr8 {
 
 
 
-		CompactGraph(std::size_t size, vertex_t* vertices, vertex_t* edges, cost_t* weights, vertex_t* ids) noexcept :
-			vertex_count(size), vertices(vertices), edges(edges), weights(weights), edge_ids(ids){
+		// The arrays weights, ids and mask cover both the edges in the base and in the delta, if any. When `ids' is
+		// nullptr, the edge ids are dense and start from `ids_seqbase'.
+		CompactGraph(std::size_t size, vertex_t* vertices, vertex_t* edges, cost_t* weights, vertex_t* ids, const uint64_t* mask = nullptr,
+				std::size_t delta_count = 0, vertex_t* delta_src = nullptr, vertex_t* delta_dst = nullptr, vertex_t ids_seqbase = 0) noexcept :
+			vertex_count(size), vertices(vertices), edges(edges), weights(weights), edge_ids(ids), edge_ids_seqbase(ids_seqbase), mask(mask),
+			delta_count(delta_count), delta_src(delta_src), delta_dst(delta_dst){
 		}
 
 		~CompactGraph() noexcept { /* nop */ }
@@ -160,16 +216,181 @@ namespace gr8 {
 		std::size_t size() const noexcept { return num_vertices(); } // alias
 
 		std::size_t num_edges() const noexcept {
+			return num_base_edges() + delta_count;
+		}
+
+		// Number of edges in the compact form, excluding the delta
+		std::size_t num_base_edges() const noexcept {
 			return vertex_count== 0 ? 0 : vertices[vertex_count -1];
 		}
 
+		// Are some of the edges disabled by a mask?
+		bool masked() const noexcept {
+			return mask != nullptr;
+		}
+
+		// All edges of `vertex_id' in the base, ignoring the mask and the delta. It requires materialised edge ids.
 		iterator_make<W> operator[] (vertex_t vertex_id) const noexcept {
 			assert(vertex_id < size());
+			assert(edge_ids != nullptr && "Dense edge ids, use for_each");
 
 			std::size_t offset = vertex_id == 0 ? 0 : vertices[vertex_id -1];
 			return iterator_make<W>(edges + offset, weights + offset, edge_ids + offset, edges + vertices[vertex_id]);
 		}
 
+		// Invoke fn(edge) for each enabled outgoing edge of `vertex_id'
+		template<typename Fn>
+		void for_each(vertex_t vertex_id, Fn&& fn) const {
+			assert(vertex_id < size());
+			const std::size_t begin = vertex_id == 0 ? 0 : vertices[vertex_id -1];
+			const std::size_t end = vertices[vertex_id];
+			for(std::size_t i = begin; i < end; i++){
+				if(enabled(i)) fn(make_edge(edges[i], i));
+			}
+			for_each_delta(vertex_id, fn);
+		}
+
+		// Invoke fn(edge) for each enabled outgoing edge of `vertex_id', where `lookup' is an array indexed by the
+		// vertex ids, usually the distances of a search, that fn is going to access at the destination of the edge.
+		// If the build defines COMPACTGRAPH_PREFETCH, the edges are visited in batches of that size and the entries
+		// of `lookup' are prefetched one batch in advance, rather than waiting on a cache miss at each edge.
+		template<typename T, typename Fn>
+		void for_each(vertex_t vertex_id, const T* lookup, Fn&& fn) const {
+			if(masked()){ // keep the mask out of the common loop
+				for_each(vertex_id, fn);
+				return;
+			}
+
+			assert(vertex_id < size());
+			const std::size_t begin = vertex_id == 0 ? 0 : vertices[vertex_id -1];
+			const std::size_t end = vertices[vertex_id];
+
+#if defined(COMPACTGRAPH_PREFETCH) && COMPACTGRAPH_PREFETCH > 0
+			constexpr std::size_t batch_size = COMPACTGRAPH_PREFETCH;
+			prefetch(lookup, begin, std::min(end, begin + batch_size));
+			for(std::size_t i = begin; i < end; i += batch_size){
+				const std::size_t batch_end = std::min(end, i + batch_size);
+				prefetch(lookup, batch_end, std::min(end, batch_end + batch_size)); // next batch
+				for(std::size_t j = i; j < batch_end; j++){
+					fn(make_edge(edges[j], j));
+				}
+			}
+#else
+			(void) lookup; // unused
+			for(std::size_t i = begin; i < end; i++){
+				fn(make_edge(edges[i], i));
+			}
+#endif
+			for_each_delta(vertex_id, fn);
+		}
+
+		// Invoke fn(edge) for the outgoing edges of `vertex_id' that may improve the distance of their destination,
+		// that is d + cost <= bound and d + cost < distances[dest]. On cpus with AVX2 or AVX-512, the edges of
+		// high degree vertices are first filtered with the vectorised kernels, otherwise all edges are visited.
+		// In both cases fn must still check the condition.
+		template<typename T, typename Fn>
+		typename std::enable_if<simd::relax_supported<V, W, T>::value>::type
+		for_each_improving(vertex_t vertex_id, const T* distances, T d, T bound, Fn&& fn) const {
+#if defined(COMPACTGRAPH_SIMD)
+			assert(vertex_id < size());
+			const std::size_t begin = vertex_id == 0 ? 0 : vertices[vertex_id -1];
+			const std::size_t end = vertices[vertex_id];
+			const simd::Level level = simd::level();
+			if(level == simd::Level::none || end - begin < simd::RELAX_MIN_DEGREE){
+				for_each(vertex_id, distances, fn);
+				return;
+			}
+
+			uint32_t positions[simd::RELAX_CHUNK];
+			for(std::size_t i = begin; i < end; i += simd::RELAX_CHUNK){
+				const std::size_t n = std::min(simd::RELAX_CHUNK, end - i);
+				const std::size_t count = (level == simd::Level::avx512) ?
+						simd::filter_avx512(edges + i, weights + i, n, distances, d, bound, positions) :
+						simd::filter_avx2(edges + i, weights + i, n, distances, d, bound, positions);
+				for(std::size_t k = 0; k < count; k++){
+					const std::size_t j = i + positions[k];
+					if(enabled(j)) fn(make_edge(edges[j], j));
+				}
+			}
+			for_each_delta(vertex_id, fn);
+#else
+			for_each(vertex_id, distances, fn);
+#endif
+		}
+
+		template<typename T, typename Fn>
+		typename std::enable_if<!simd::relax_supported<V, W, T>::value>::type
+		for_each_improving(vertex_t vertex_id, const T* distances, T, T, Fn&& fn) const {
+			for_each(vertex_id, distances, fn);
+		}
+
+	};
+
+	// In-edges of a CompactGraph, in the same compact form. The edge id of each in-edge is the id of the
+	// original edge, the arrays are owned by this object. Only the enabled edges are transposed.
+	template<typename V, typename W = void>
+	class CompactGraphTranspose {
+	public:
+		using graph_t = CompactGraph<V, W>;
+		using vertex_t = typename graph_t::vertex_t;
+		using cost_t = typename graph_t::cost_t;
+
+	private:
+		std::unique_ptr<vertex_t[]> vertices;
+		std::unique_ptr<vertex_t[]> edges;
+		std::unique_ptr<cost_t[]> weights;
+		std::unique_ptr<vertex_t[]> edge_ids;
+		graph_t graph;
+
+		CompactGraphTranspose(const CompactGraphTranspose&) = delete;
+		CompactGraphTranspose& operator=(CompactGraphTranspose&) = delete;
+
+		template<typename E, typename type = W>
+		static typename std::enable_if<!std::is_void<type>::value>::type set_cost(cost_t* __restrict w, std::size_t pos, const E& e) noexcept {
+			w[pos] = e.cost();
+		}
+
+		template<typename E, typename type = W>
+		static typename std::enable_if<std::is_void<type>::value>::type set_cost(cost_t*, std::size_t, const E&) noexcept { }
+
+	public:
+		CompactGraphTranspose(const graph_t& G) :
+			vertices(new vertex_t[G.num_vertices()]), edges(new vertex_t[G.num_edges()]),
+			weights(std::is_void<W>::value ? nullptr : new cost_t[G.num_edges()]), edge_ids(new vertex_t[G.num_edges()]),
+			graph(G.num_vertices(), vertices.get(), edges.get(), weights.get(), edge_ids.get()) {
+			const std::size_t num_vertices = G.num_vertices();
+			if(num_vertices == 0) return;
+			vertex_t* __restrict R = vertices.get();
+
+			// in-degree of each vertex
+			for(std::size_t i = 0; i < num_vertices; i++){ R[i] = 0; }
+			for(std::size_t u = 0; u < num_vertices; u++){
+				G.for_each(u, [R](const typename graph_t::edge_t& e){ R[e.dest()]++; });
+			}
+
+			// prefix sum, R[v] is the end of the in-edges of v
+			vertex_t sum = 0;
+			for(std::size_t v = 0; v < num_vertices; v++){
+				sum += R[v];
+				R[v] = sum;
+			}
+
+			// place the edges, at the end R[v] is the start of the in-edges of v
+			for(std::size_t u = 0; u < num_vertices; u++){
+				G.for_each(u, [&](const typename graph_t::edge_t& e){
+					std::size_t pos = --R[e.dest()];
+					edges[pos] = u;
+					edge_ids[pos] = e.id();
+					set_cost(weights.get(), pos, e);
+				});
+			}
+
+			// back to the end offsets
+			for(std::size_t v = 0; v < num_vertices -1; v++){ R[v] = R[v+1]; }
+			R[num_vertices -1] = sum;
+		}
+
+		const graph_t& get() const noexcept { return graph; }
 	};
 
 } /*namespace gr8 */
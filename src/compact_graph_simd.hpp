@@ -0,0 +1,178 @@
+/*
+ * compact_graph_simd.hpp
+ * Vectorised kernels to relax the edges of a CompactGraph. The kernels are compiled for AVX2 and AVX-512
+ * through the target attribute and selected at runtime, so the library still runs on cpus without them.
+ */
+
+#ifndef COMPACT_GRAPH_SIMD_HPP_
+#define COMPACT_GRAPH_SIMD_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if (defined(__GNUG__) or defined(__clang__)) and defined(__x86_64__) // gcc & clang only
+#define COMPACTGRAPH_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace gr8 { namespace simd {
+
+	// Instruction sets available for the kernels
+	enum class Level { none, avx2, avx512 };
+
+	// Min out-degree of a vertex to use the kernels
+	constexpr std::size_t RELAX_MIN_DEGREE = 16; // arbitrary value
+
+	// Number of edges filtered by each invocation of a kernel
+	constexpr std::size_t RELAX_CHUNK = 64; // arbitrary value
+
+	// Instruction set supported by the current cpu, detected once
+	inline Level level(){
+#if defined(COMPACTGRAPH_SIMD)
+		static const Level value = [](){
+			__builtin_cpu_init();
+			if(__builtin_cpu_supports("avx512f")) return Level::avx512;
+			if(__builtin_cpu_supports("avx2")) return Level::avx2;
+			return Level::none;
+		}();
+		return value;
+#else
+		return Level::none;
+#endif
+	}
+
+	// Can the kernels relax the edges with vertices V, weights W and distances D? The lanes are 64-bit signed
+	// integers, the vertex ids are used as gather indices and weights and distances are sign extended.
+	template<typename V, typename W, typename D>
+	struct relax_supported : std::integral_constant<bool,
+#if defined(COMPACTGRAPH_SIMD)
+		std::is_integral<V>::value && sizeof(V) == 8 &&
+		std::is_integral<W>::value && std::is_signed<W>::value && (sizeof(W) == 4 || sizeof(W) == 8) &&
+		std::is_integral<D>::value && std::is_signed<D>::value && (sizeof(D) == 4 || sizeof(D) == 8)
+#else
+		false
+#endif
+	> { };
+
+#if defined(COMPACTGRAPH_SIMD)
+namespace internal {
+
+	// tag for the size of the loaded elements
+	template<std::size_t N>
+	using width = std::integral_constant<std::size_t, N>;
+
+	/**
+	 * AVX2, 4 lanes
+	 */
+	template<typename T>
+	__attribute__((target("avx2"))) inline __m256i load_avx2(const T* p, width<4>){
+		return _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+	}
+
+	template<typename T>
+	__attribute__((target("avx2"))) inline __m256i load_avx2(const T* p, width<8>){
+		return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+	}
+
+	template<typename T>
+	__attribute__((target("avx2"))) inline __m256i gather_avx2(const T* base, __m256i index, width<4>){
+		return _mm256_cvtepi32_epi64(_mm256_i64gather_epi32(reinterpret_cast<const int*>(base), index, 4));
+	}
+
+	template<typename T>
+	__attribute__((target("avx2"))) inline __m256i gather_avx2(const T* base, __m256i index, width<8>){
+		return _mm256_i64gather_epi64(reinterpret_cast<const long long*>(base), index, 8);
+	}
+
+	/**
+	 * AVX-512, 8 lanes. Use the masked intrinsics, the unmasked ones trigger spurious -Wmaybe-uninitialized in gcc
+	 */
+	template<typename T>
+	__attribute__((target("avx512f"))) inline __m512i load_avx512(const T* p, width<4>){
+		return _mm512_maskz_cvtepi32_epi64(0xFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+	}
+
+	template<typename T>
+	__attribute__((target("avx512f"))) inline __m512i load_avx512(const T* p, width<8>){
+		return _mm512_loadu_si512(p);
+	}
+
+	template<typename T>
+	__attribute__((target("avx512f"))) inline __m512i gather_avx512(const T* base, __m512i index, width<4>){
+		return _mm512_maskz_cvtepi32_epi64(0xFF, _mm512_mask_i64gather_epi32(_mm256_setzero_si256(), 0xFF, index, base, 4));
+	}
+
+	template<typename T>
+	__attribute__((target("avx512f"))) inline __m512i gather_avx512(const T* base, __m512i index, width<8>){
+		return _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xFF, index, base, 8);
+	}
+
+} // namespace internal
+
+	/**
+	 * Write in `out' the positions i in [0, n) of the edges such that d + weights[i] <= bound and
+	 * d + weights[i] < distances[edges[i]], and return their number. The distances are read before any
+	 * update: when the same destination occurs twice, both edges are reported and the caller must check
+	 * them again while relaxing them in order.
+	 */
+	template<typename V, typename W, typename D>
+	__attribute__((target("avx2"))) std::size_t filter_avx2(const V* edges, const W* weights, std::size_t n, const D* distances, int64_t d, int64_t bound, uint32_t* out){
+		const __m256i vd = _mm256_set1_epi64x(d);
+		const __m256i vbound = _mm256_set1_epi64x(bound);
+		std::size_t count = 0;
+		std::size_t i = 0;
+
+		for( ; i + 4 <= n; i += 4){
+			__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(edges + i));
+			__m256i td = _mm256_add_epi64(vd, internal::load_avx2(weights + i, internal::width<sizeof(W)>()));
+			__m256i current = internal::gather_avx2(distances, index, internal::width<sizeof(D)>());
+			__m256i improved = _mm256_andnot_si256(_mm256_cmpgt_epi64(td, vbound), _mm256_cmpgt_epi64(current, td));
+			unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(improved));
+			while(mask){
+				out[count++] = i + __builtin_ctz(mask);
+				mask &= mask -1;
+			}
+		}
+
+		// tail
+		for( ; i < n; i++){
+			int64_t td = d + weights[i];
+			if(td <= bound && td < distances[edges[i]]) out[count++] = i;
+		}
+
+		return count;
+	}
+
+	// As filter_avx2, with 8 lanes
+	template<typename V, typename W, typename D>
+	__attribute__((target("avx512f"))) std::size_t filter_avx512(const V* edges, const W* weights, std::size_t n, const D* distances, int64_t d, int64_t bound, uint32_t* out){
+		const __m512i vd = _mm512_set1_epi64(d);
+		const __m512i vbound = _mm512_set1_epi64(bound);
+		std::size_t count = 0;
+		std::size_t i = 0;
+
+		for( ; i + 8 <= n; i += 8){
+			__m512i index = _mm512_loadu_si512(edges + i);
+			__m512i td = _mm512_add_epi64(vd, internal::load_avx512(weights + i, internal::width<sizeof(W)>()));
+			__m512i current = internal::gather_avx512(distances, index, internal::width<sizeof(D)>());
+			unsigned mask = _mm512_cmpgt_epi64_mask(current, td) & _mm512_cmple_epi64_mask(td, vbound);
+			while(mask){
+				out[count++] = i + __builtin_ctz(mask);
+				mask &= mask -1;
+			}
+		}
+
+		// tail
+		for( ; i < n; i++){
+			int64_t td = d + weights[i];
+			if(td <= bound && td < distances[edges[i]]) out[count++] = i;
+		}
+
+		return count;
+	}
+#endif
+
+}} // namespace gr8::simd
+
+#endif /* COMPACT_GRAPH_SIMD_HPP_ */
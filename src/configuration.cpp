@@ -7,10 +7,11 @@
 
 #include "configuration.hpp"
 
+#include <cstdlib>
 #include <cstring>
-#include <iostream>
 
 #include "errorhandling.hpp"
+#include "graph_index.hpp"
 #include "monetdb_config.hpp"
 
 using namespace gr8;
@@ -32,6 +33,27 @@ void Configuration::initialise(){
 	char* env_debug = getenv("GRAPH_DUMP_PARSER");
 	instance._dump_parser = env_debug != nullptr && (strcmp(env_debug, "1") == 0 || strcmp(env_debug, "true") == 0);
 
+	// cache of the compact graphs built from persistent edge columns
+	char* env_graph_cache = getenv("GRAPH_CACHE_SIZE");
+	instance._graph_cache_size = env_graph_cache != nullptr ? atoi(env_graph_cache) : 4;
+	CHECK(instance._graph_cache_size >= 0, "Invalid value for GRAPH_CACHE_SIZE: " << env_graph_cache);
+
+	// cache of the search trees, in MB, disabled by default
+	char* env_tree_cache = getenv("GRAPH_TREE_CACHE_MB");
+	int tree_cache_mb = env_tree_cache != nullptr ? atoi(env_tree_cache) : 0;
+	CHECK(tree_cache_mb >= 0, "Invalid value for GRAPH_TREE_CACHE_MB: " << env_tree_cache);
+	instance._tree_cache_memory = (std::size_t) tree_cache_mb << 20;
+
+	// memory retained by the search workspaces of each thread, in MB, 0 to free them after each search
+	char* env_workspace_cache = getenv("GRAPH_WORKSPACE_CACHE_MB");
+	int workspace_cache_mb = env_workspace_cache != nullptr ? atoi(env_workspace_cache) : 256;
+	CHECK(workspace_cache_mb >= 0, "Invalid value for GRAPH_WORKSPACE_CACHE_MB: " << env_workspace_cache);
+	instance._workspace_cache_memory = (std::size_t) workspace_cache_mb << 20;
+
+	// index of the compact graphs in the farm, disabled by default
+	char* env_persistent_index = getenv("GRAPH_PERSISTENT_INDEX");
+	instance._persistent_index = env_persistent_index != nullptr && (strcmp(env_persistent_index, "1") == 0 || strcmp(env_persistent_index, "true") == 0);
+
 	// nested table type
 	int TYPE_nested_table = ATOMindex("nestedtable");
 	CHECK(TYPE_nested_table >= 0, "Type 'nestedtable' not found");
@@ -50,13 +72,9 @@ extern "C" { // initialise the global configuration
 str GRAPHprelude(void*){
 	try {
 		Configuration::initialise();
+		if(configuration().persistent_index()){ drop_orphan_graph_indexes(); } // best effort
 	} catch (gr8::Exception& e){ // no exception shall pass!
-		std::cerr << ">> Exception " << e.getExceptionClass() << " raised at " << e.getFile() << ", line: " << e.getLine() << "\n";
-		std::cerr << ">> Cause: " << e.what() << "\n";
-		std::cerr << ">> Caught at: " << __FUNCTION__ << "\n";
-		std::cerr << ">> Operation failed!" << std::endl;
-
-		return createException(MAL, "GRAPHprelude", e.what());
+		return handle_exception("GRAPHprelude", e);
 	} catch (...){
 		return createException(MAL, "GRAPHprelude", OPERATION_FAILED);
 	}
@@ -8,6 +8,8 @@
 #ifndef SRC_CONFIGURATION_HPP_
 #define SRC_CONFIGURATION_HPP_
 
+#include <cstddef>
+
 #include "errorhandling.hpp"
 
 namespace gr8 {
@@ -19,6 +21,10 @@ private:
 	bool _dump_parser; // whether the parser should dump to stdout the incoming request (for debug purposes)
 	bool _initialised; // has the singleton instance been initialised?
 	int _type_nested_table; // reference to the physical type representing a nested table
+	int _graph_cache_size; // max number of compact graphs retained across the queries, 0 to disable
+	std::size_t _tree_cache_memory; // max memory, in bytes, for the search trees retained across the queries, 0 to disable
+	std::size_t _workspace_cache_memory; // max memory, in bytes, for the search workspaces retained by each thread
+	bool _persistent_index; // whether the compact graphs of persistent columns are also stored in the farm
 
 public:
 	bool dump_parser() const {
@@ -33,6 +39,22 @@ public:
 		return _type_nested_table;
 	}
 
+	int graph_cache_size() const {
+		return _graph_cache_size;
+	}
+
+	std::size_t tree_cache_memory() const {
+		return _tree_cache_memory;
+	}
+
+	std::size_t workspace_cache_memory() const {
+		return _workspace_cache_memory;
+	}
+
+	bool persistent_index() const {
+		return _persistent_index;
+	}
+
 
 private:
 	// singleton interface
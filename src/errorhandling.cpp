@@ -7,6 +7,10 @@
 
 #include "errorhandling.hpp"
 
+#include <iostream>
+
+#include "monetdb_config.hpp"
+
 using namespace std;
 using namespace gr8;
 
@@ -26,3 +30,16 @@ std::ostream& operator<<(std::ostream& out, Exception& e){
             "line: " << e.getLine() << ", function: `" << e.getFunction() << "']";
     return out;
 }
+
+char* gr8::handle_exception(const char* function_name, Exception& e){
+	cerr << ">> Exception " << e.getExceptionClass() << " raised at " << e.getFile() << ", line: " << e.getLine() << "\n";
+	cerr << ">> Cause: " << e.what() << "\n";
+	cerr << ">> Operation failed!" << endl;
+
+	const char* mal_error = dynamic_cast<MalException*>(&e) ? ((MalException*) &e)->get_mal_error() : OPERATION_FAILED;
+	if(e.what()[0] == '\0'){ // no details
+		return createException(MAL, function_name, "%s", mal_error);
+	} else {
+		return createException(MAL, function_name, "%s: %s", mal_error, e.what());
+	}
+}
@@ -136,4 +136,17 @@ public:
 #define MAL_ASSERT_RC() MAL_ASSERT(rc == MAL_SUCCEED, rc)
 #define MAL_ASSERT_MSG(condition, mal_error, message) if(!(condition)) { MAL_ERROR(mal_error, message); }
 
+namespace gr8 {
+
+/**
+ * Report an exception raised inside a MAL function: log it and convert it into a MAL error, with the message of
+ * the exception as details, if any
+ * @param function_name the name of the MAL function, e.g. graph.spfw
+ * @param e the exception caught
+ * @return the MAL error to return
+ */
+char* handle_exception(const char* function_name, Exception& e);
+
+}
+
 #endif /* ERRORHANDLING_HPP_ */
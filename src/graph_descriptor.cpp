@@ -26,8 +26,8 @@ GraphDescriptor::~GraphDescriptor() { }
  *                                                                            *
  ******************************************************************************/
 
-GraphDescriptorColumns::GraphDescriptorColumns(BatHandle&& edge_src, BatHandle&& edge_dst) :
-		edge_src(move(edge_src)), edge_dst(move(edge_dst)) { }
+GraphDescriptorColumns::GraphDescriptorColumns(BatHandle&& edge_src, BatHandle&& edge_dst, BatHandle&& edge_mask) :
+		edge_src(move(edge_src)), edge_dst(move(edge_dst)), edge_mask(move(edge_mask)) { }
 
 GraphDescriptorColumns::~GraphDescriptorColumns() { }
 
@@ -47,8 +47,8 @@ bool GraphDescriptorColumns::empty() const {
  *                                                                            *
  ******************************************************************************/
 
-GraphDescriptorCompact::GraphDescriptorCompact(BatHandle&& edge_src, BatHandle&& edge_dst, BatHandle&& edge_id, std::size_t vertex_count) :
-		edge_src(move(edge_src)), edge_dst(move(edge_dst)), edge_id(move(edge_id)), vertex_count(vertex_count) { }
+GraphDescriptorCompact::GraphDescriptorCompact(BatHandle&& edge_src, BatHandle&& edge_dst, BatHandle&& edge_id, std::size_t vertex_count, BatHandle&& vertex_ids) :
+		edge_src(move(edge_src)), edge_dst(move(edge_dst)), edge_id(move(edge_id)), vertex_count(vertex_count), vertex_ids(move(vertex_ids)) { }
 
 GraphDescriptorCompact::~GraphDescriptorCompact() { }
 
@@ -60,3 +60,15 @@ bool GraphDescriptorCompact::empty() const {
 	assert(edge_src.empty() == edge_dst.empty());
 	return edge_src.empty();
 }
+
+bool GraphDescriptorCompact::remapped() const {
+	return vertex_ids.initialised();
+}
+
+bool GraphDescriptorCompact::masked() const {
+	return !edge_mask.empty();
+}
+
+std::size_t GraphDescriptorCompact::delta_size() const {
+	return delta_src.initialised() ? delta_src.size() : 0;
+}
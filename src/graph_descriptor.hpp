@@ -11,7 +11,9 @@
 #include "bat_handle.hpp"
 #include "compact_graph.hpp"
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace gr8 {
 
@@ -36,8 +38,9 @@ class GraphDescriptorColumns : public GraphDescriptor {
 public:
 	BatHandle edge_src;
 	BatHandle edge_dst;
+	BatHandle edge_mask; // edges to consider, either a candidate list over the edge ids or a bit column, empty for all edges
 
-	GraphDescriptorColumns(BatHandle&& edge_src, BatHandle&& edge_dst);
+	GraphDescriptorColumns(BatHandle&& edge_src, BatHandle&& edge_dst, BatHandle&& edge_mask = BatHandle{});
 	~GraphDescriptorColumns();
 
 	GraphDescriptorType get_type() const;
@@ -51,18 +54,53 @@ public:
 	BatHandle edge_dst;
 	BatHandle edge_id;
 	std::size_t vertex_count;
+	BatHandle vertex_ids; // original id of each vertex when the domain has been compacted, empty otherwise
+	std::vector<uint64_t> edge_mask; // bitmap over the positions of edge_id of the enabled edges, empty for all edges
+	BatHandle delta_src; // edges appended or updated after the compact form was built, sorted by source, empty if none
+	BatHandle delta_dst;
+	uint64_t version = 0; // identifies the content of a cached graph, 0 if not cached or masked by the query
 
-	GraphDescriptorCompact(BatHandle&& edge_src, BatHandle&& edge_dst, BatHandle&& edge_id, std::size_t vertex_count);
+	GraphDescriptorCompact(BatHandle&& edge_src, BatHandle&& edge_dst, BatHandle&& edge_id, std::size_t vertex_count, BatHandle&& vertex_ids = BatHandle{});
 	~GraphDescriptorCompact();
 
 	GraphDescriptorType get_type() const;
 	bool empty() const;
 
+	// Has the domain of the vertex ids been compacted?
+	bool remapped() const;
+
+	// Are some of the edges disabled?
+	bool masked() const;
+
+	// Number of edges in the delta
+	std::size_t delta_size() const;
+
+	// Raw array of an optional column
+	static oid* delta_array(const BatHandle& column) {
+		return column.initialised() ? column.array<oid>() : nullptr;
+	}
+
+	// Raw array of the edge ids for the CompactGraph, nullptr if the column is dense
+	oid* edge_id_array() const {
+		return edge_id.dense() ? nullptr : edge_id.array<oid>();
+	}
+
+	// First edge id of a dense column
+	oid edge_id_seqbase() const {
+		return edge_id.dense() ? edge_id.get()->T.seq : 0;
+	}
+
+	// Bitmap of the enabled edges for the CompactGraph, nullptr if all edges are enabled
+	const uint64_t* mask() const {
+		return masked() ? edge_mask.data() : nullptr;
+	}
+
 	std::shared_ptr<CompactGraph<oid>> instantiate() {
 		typedef std::shared_ptr<CompactGraph<oid>> pointer_t;
 
 		// std::size_t size, vertex_t* vertices, vertex_t* edges, cost_t* weights
-		return pointer_t { new CompactGraph<oid>(vertex_count, edge_src.array<oid>(), edge_dst.array<oid>(), nullptr, edge_id.array<oid>()) };
+		return pointer_t { new CompactGraph<oid>(vertex_count, edge_src.array<oid>(), edge_dst.array<oid>(), nullptr, edge_id_array(), mask(),
+				delta_size(), delta_array(delta_src), delta_array(delta_dst), edge_id_seqbase()) };
 	}
 
 	template <typename W>
@@ -70,7 +108,8 @@ public:
 		typedef std::shared_ptr<CompactGraph<oid, W>> pointer_t;
 
 		// std::size_t size, vertex_t* vertices, vertex_t* edges, cost_t* weights
-		return pointer_t { new CompactGraph<oid, W>(vertex_count, edge_src.array<oid>(), edge_dst.array<oid>(), weights.array<W>(), edge_id.array<oid>()) };
+		return pointer_t { new CompactGraph<oid, W>(vertex_count, edge_src.array<oid>(), edge_dst.array<oid>(), weights.array<W>(), edge_id_array(), mask(),
+				delta_size(), delta_array(delta_src), delta_array(delta_dst), edge_id_seqbase()) };
 	}
 
 };
@@ -0,0 +1,215 @@
+/*
+ * graph_index.cpp
+ * The index of the edge columns <src, dst> is made of a descriptor, a persistent BAT of lng named
+ * graph_index_<src>_<dst>, and the columns of the compact graph, named after the descriptor and its generation.
+ */
+
+#include "graph_index.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "monetdb_config.hpp"
+
+using namespace gr8;
+using namespace std;
+
+// Layout of the index, bump it when its content changes
+static constexpr lng GRAPH_INDEX_FORMAT = 2;
+
+namespace {
+
+// Entries of the descriptor
+enum DescriptorEntry {
+	d_format = 0, // GRAPH_INDEX_FORMAT
+	d_size, // number of edges
+	d_checksum_src, // hash of the content of the edge columns
+	d_checksum_dst,
+	d_generation, // incremented each time the index is replaced
+	d_vertex_count,
+	d_vertices, // bat ids of the columns, 0 if absent
+	d_edges,
+	d_edge_ids,
+	d_vertex_ids,
+	d_num_entries
+};
+
+} // anonymous namespace
+
+// Serialise the updates of the indexes
+static mutex& index_mutex(){
+	static mutex* instance = new mutex();
+	return *instance;
+}
+
+static string descriptor_name(const GraphDescriptorColumns* graph){
+	return "graph_index_" + to_string(graph->edge_src.id()) + "_" + to_string(graph->edge_dst.id());
+}
+
+// Hash of all values of an edge column, an update in place also changes it
+static lng checksum(const BatHandle& column){
+	return (lng) content_hash(column, 0, column.size());
+}
+
+// Make the given column persistent under the given name
+static bool make_persistent(const BatHandle& column, const string& name){
+	if(BBPrename(column.id(), name.c_str()) != 0) return false;
+	return BATmode(column.get(), PERSISTENT) == GDK_SUCCEED;
+}
+
+// Make the columns of the index in the descriptor D transient, to be removed at the next commit
+static void drop_columns(const lng* D, vector<bat>& commit){
+	for(int entry : { d_vertices, d_edges, d_edge_ids, d_vertex_ids }){
+		if(D[entry] == 0) continue;
+		BAT* column = BATdescriptor((bat) D[entry]);
+		if(column == nullptr) continue;
+		if(BATmode(column, TRANSIENT) == GDK_SUCCEED) commit.push_back(column->batCacheid);
+		BBPunfix(column->batCacheid);
+	}
+}
+
+// Is the given bat an existing persistent column?
+static bool persistent_column(bat id){
+	if(id <= 0 || id >= getBBPsize() || !BBPvalid(id)) return false;
+	BAT* b = BBPquickdesc(id, 0);
+	return b != nullptr && b->batPersistence == PERSISTENT;
+}
+
+// Drop the indexes whose edge columns have been removed or made transient, to be committed by the caller
+static void drop_orphans(vector<bat>& commit){
+	for(bat i = 1, sz = getBBPsize(); i < sz; i++){
+		if(!BBPvalid(i)) continue;
+		bat src = 0, dst = 0;
+		int length = 0;
+		const char* name = BBP_logical(i);
+		if(sscanf(name, "graph_index_%d_%d%n", &src, &dst, &length) != 2 || name[length] != '\0') continue; // not a descriptor
+		if(persistent_column(src) && persistent_column(dst)) continue;
+
+		BAT* descriptor = BATdescriptor(i);
+		if(descriptor == nullptr) continue;
+		if(descriptor->ttype == TYPE_lng && BATcount(descriptor) == d_num_entries){
+			drop_columns((const lng*) Tloc(descriptor, 0), commit);
+		}
+		if(BATmode(descriptor, TRANSIENT) == GDK_SUCCEED) commit.push_back(i);
+		BBPunfix(i);
+	}
+}
+
+bool gr8::load_graph_index(const GraphDescriptorColumns* graph, GraphIndex& index){
+	const string name = descriptor_name(graph);
+	if(BBPindex(name.c_str()) == 0) return false; // no index, skip the checksums
+	const lng checksum_src = checksum(graph->edge_src); // outside the critical section, a scan of the edges
+	const lng checksum_dst = checksum(graph->edge_dst);
+
+	lock_guard<mutex> lock(index_mutex());
+	bat id = BBPindex(name.c_str());
+	if(id == 0) return false;
+	BatHandle descriptor { id };
+	if(descriptor.get()->ttype != TYPE_lng || descriptor.size() != d_num_entries) return false;
+
+	const lng* D = descriptor.array<lng>();
+	if(D[d_format] != GRAPH_INDEX_FORMAT || D[d_size] != (lng) graph->edge_src.size() ||
+			D[d_checksum_src] != checksum_src || D[d_checksum_dst] != checksum_dst){
+		return false; // stale
+	}
+
+	index.vertices = BatHandle{ (bat) D[d_vertices] };
+	index.edges = BatHandle{ (bat) D[d_edges] };
+	index.edge_ids = BatHandle{ (bat) D[d_edge_ids] };
+	index.vertex_ids = D[d_vertex_ids] != 0 ? BatHandle{ (bat) D[d_vertex_ids] } : BatHandle{};
+	index.vertex_count = (size_t) D[d_vertex_count];
+	return true;
+}
+
+bool gr8::save_graph_index(const GraphDescriptorColumns* graph, const GraphIndex& index){
+	const string name = descriptor_name(graph);
+	const lng checksum_src = checksum(graph->edge_src); // outside the critical section, a scan of the edges
+	const lng checksum_dst = checksum(graph->edge_dst);
+
+	lock_guard<mutex> lock(index_mutex());
+	vector<bat> commit { 0 }; // the first slot is ignored by TMsubcommit_list
+	drop_orphans(commit); // along with this commit
+
+	// retrieve the descriptor, the columns of the previous index are dropped once it has been overwritten
+	BatHandle descriptor;
+	lng previous[d_num_entries] = {0};
+	bat id = BBPindex(name.c_str());
+	if(id != 0){
+		descriptor = BatHandle{ id };
+		if(descriptor.get()->ttype != TYPE_lng || descriptor.size() != d_num_entries) return false;
+		const lng* D = descriptor.array<lng>();
+		std::copy(D, D + d_num_entries, previous);
+	} else {
+		descriptor = BatHandle{ COLnew(0, TYPE_lng, d_num_entries, TRANSIENT) };
+		if(!descriptor.initialised()) return false;
+		const lng zero = 0;
+		for(int i = 0; i < d_num_entries; i++){
+			if(BUNappend(descriptor.get(), &zero, false) != GDK_SUCCEED) return false;
+		}
+		if(!make_persistent(descriptor, name)) return false;
+	}
+	const lng generation = previous[d_generation] +1;
+
+	// the columns of the new index
+	const string prefix = name + "_" + to_string(generation);
+	const BatHandle* columns[] = { &index.vertices, &index.edges, &index.edge_ids, &index.vertex_ids };
+	const char* suffixes[] = { "_vertices", "_edges", "_ids", "_vertex_ids" };
+	size_t num_persistent = 0;
+	auto revert = [&](){ // these columns have not been committed yet
+		for(size_t i = 0; i < num_persistent; i++){
+			if(columns[i]->initialised()) BATmode(columns[i]->get(), TRANSIENT);
+		}
+	};
+	bool success = true;
+	for(size_t i = 0; success && i < 4; i++){
+		if(!columns[i]->initialised()) continue;
+		success = make_persistent(*columns[i], prefix + suffixes[i]);
+		if(success) num_persistent = i +1;
+	}
+	lng values[d_num_entries] = {0};
+	if(success){
+		values[d_format] = GRAPH_INDEX_FORMAT;
+		values[d_size] = (lng) graph->edge_src.size();
+		values[d_checksum_src] = checksum_src;
+		values[d_checksum_dst] = checksum_dst;
+		values[d_vertex_count] = (lng) index.vertex_count;
+		values[d_vertices] = index.vertices.id();
+		values[d_edges] = index.edges.id();
+		values[d_edge_ids] = index.edge_ids.id();
+		values[d_vertex_ids] = index.vertex_ids.initialised() ? index.vertex_ids.id() : 0;
+		for(const BatHandle* column : columns){
+			if(column->initialised()) commit.push_back(column->id());
+		}
+	} else {
+		revert();
+	}
+	values[d_generation] = generation; // always advance, the names of a failed attempt may already be taken
+
+	// update the descriptor. It is invalidated first, a failed write never pairs the entries of two indexes
+	const lng invalid = 0;
+	if(BUNinplace(descriptor.get(), d_format, &invalid, true) != GDK_SUCCEED){
+		revert(); // the previous index is still in place
+		return false;
+	}
+	drop_columns(previous, commit);
+	bool updated = true;
+	for(int i = d_format +1; updated && i < d_num_entries; i++){
+		updated = BUNinplace(descriptor.get(), i, &values[i], true) == GDK_SUCCEED;
+	}
+	updated = updated && BUNinplace(descriptor.get(), d_format, &values[d_format], true) == GDK_SUCCEED;
+	if(!updated && success) revert(); // the descriptor stays invalid
+	commit.push_back(descriptor.id());
+
+	return TMsubcommit_list(commit.data(), (int) commit.size()) == GDK_SUCCEED && success && updated;
+}
+
+bool gr8::drop_orphan_graph_indexes(){
+	lock_guard<mutex> lock(index_mutex());
+	vector<bat> commit { 0 };
+	drop_orphans(commit);
+	return commit.size() == 1 || TMsubcommit_list(commit.data(), (int) commit.size()) == GDK_SUCCEED;
+}
@@ -0,0 +1,41 @@
+/*
+ * graph_index.hpp
+ * Compact form of persistent edge columns, stored in the GDK farm as persistent BATs and reloaded, through the
+ * storage of the GDK, after a restart of the server.
+ */
+
+#ifndef GRAPH_INDEX_HPP_
+#define GRAPH_INDEX_HPP_
+
+#include <cstddef>
+
+#include "bat_handle.hpp"
+#include "graph_descriptor.hpp"
+
+namespace gr8 {
+
+// The columns of the compact form of a graph
+struct GraphIndex {
+	BatHandle vertices; // prefix sum of the out-degrees
+	BatHandle edges; // destination of each edge, sorted by source
+	BatHandle edge_ids; // original position of each edge
+	BatHandle vertex_ids; // original id of each vertex when the domain has been compacted, empty otherwise
+	std::size_t vertex_count = 0;
+};
+
+// Retrieve the index stored for the given edge columns. Return false if there is none or it was built from a
+// different content of the columns.
+bool load_graph_index(const GraphDescriptorColumns* graph, GraphIndex& index);
+
+// Store the index of the given edge columns, replacing the previous one. The columns of the index become
+// persistent. Return false if the index could not be stored.
+bool save_graph_index(const GraphDescriptorColumns* graph, const GraphIndex& index);
+
+// Remove the indexes of the edge columns that have been dropped, or are no longer persistent. The indexes are
+// named after the ids of their columns, there is no hook on the removal of these. Invoked at startup and each
+// time an index is stored. Return false if the removal could not be committed.
+bool drop_orphan_graph_indexes();
+
+} /* namespace gr8 */
+
+#endif /* GRAPH_INDEX_HPP_ */
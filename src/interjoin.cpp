@@ -0,0 +1,387 @@
+/*
+ * interjoin.cpp
+ * graph.intersect_join_lists: intersect the left and right candidate lists, keeping the edges aligned with them.
+ * Sorted candidates are merged, four values at a time with AVX2 when both lists are strictly increasing, and
+ * large inputs are split by merge path and merged in parallel. Unsorted candidates are joined through a hash
+ * table rather than sorted. The results are written directly into the heaps of the output BATs.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "bat_handle.hpp"
+#include "compact_graph_simd.hpp"
+#include "errorhandling.hpp"
+#include "monetdb_config.hpp"
+#include "parallel.hpp"
+
+using namespace gr8;
+using namespace std;
+
+// if set, accept unsorted candidates and join them through a hash table. Otherwise assume they are already
+// sorted, i.e. codegen should ensure this property.
+//#define GRAPHinterjoinlist_SORT // set from the Makefile
+
+// Do not split the merge in parts with fewer candidates than this number
+static constexpr size_t INTERJOIN_MIN_PARALLEL = 1ull << 20; // arbitrary value
+
+namespace {
+
+// The candidate lists <left, right> and the edges <src, dst> aligned with them
+struct Input {
+	OidColumn left;
+	OidColumn right;
+	OidColumn src;
+	OidColumn dst;
+	size_t left_sz;
+	size_t right_sz;
+	bool keyed; // both lists are strictly increasing
+};
+
+// The heaps of the output BATs
+struct Output {
+	oid* candidates;
+	oid* src;
+	oid* dst;
+
+	void emit(const Input& in, size_t i, size_t j, size_t k) const {
+		candidates[k] = in.left[i];
+		src[k] = in.src[i];
+		dst[k] = in.dst[j];
+	}
+};
+
+// Chained hash table over the positions of a column. Each chain lists its positions in increasing order, a
+// position is unlinked once matched, so that duplicates are paired one to one as in the merge.
+class HashTable {
+	static constexpr size_t EMPTY = SIZE_MAX;
+
+	const OidColumn values;
+	vector<size_t> heads;
+	vector<size_t> next;
+	int shift;
+
+	size_t bucket(oid value) const {
+		return (size_t) (((uint64_t) value * 0x9E3779B97F4A7C15ull) >> shift); // Fibonacci hashing
+	}
+
+public:
+	HashTable(OidColumn values, size_t size) : values(values), next(size) {
+		int log2 = 1;
+		while((1ull << log2) < 2 * size) log2++;
+		heads.assign(1ull << log2, EMPTY);
+		shift = 64 - log2;
+
+		for(size_t i = size; i-- > 0; ){
+			size_t& head = heads[bucket(values[i])];
+			next[i] = head;
+			head = i;
+		}
+	}
+
+	// Retrieve and remove the first position with the given value, return false if there is none
+	bool take(oid value, size_t& position){
+		size_t* link = &heads[bucket(value)];
+		while(*link != EMPTY && values[*link] != value) link = &next[*link];
+		if(*link == EMPTY) return false;
+		position = *link;
+		*link = next[position];
+		return true;
+	}
+};
+
+} // anonymous namespace
+
+// Copy the values [from, from + n) of the given column
+static void copy_values(const OidColumn column, size_t from, size_t n, oid* out){
+	if(column.dense()){
+		for(size_t i = 0; i < n; i++) out[i] = column[from + i];
+	} else {
+		memcpy(out, column.data() + from, n * sizeof(oid));
+	}
+}
+
+// First position in [lo, hi) whose value is not less than the given value
+static size_t lower_bound(const OidColumn column, size_t lo, size_t hi, oid value){
+	while(lo < hi){
+		size_t mid = lo + (hi - lo) / 2;
+		if(column[mid] < value) lo = mid +1; else hi = mid;
+	}
+	return lo;
+}
+
+/******************************************************************************
+ *                                                                            *
+ *   Merge of the sorted candidates                                           *
+ *                                                                            *
+ ******************************************************************************/
+
+// Merge left[i, i_end) with right[j, j_end), writing the matches from the position k. Return the new position.
+template<typename L, typename R>
+static size_t merge_scalar(const Input& in, L left, R right, size_t i, size_t i_end, size_t j, size_t j_end, const Output& out, size_t k){
+	while(i < i_end && j < j_end){
+		oid l = left[i], r = right[j];
+		if(l == r){
+			out.emit(in, i, j, k++);
+			i++; j++;
+		} else if (l < r) {
+			i++;
+		} else { // l > r
+			j++;
+		}
+	}
+	return k;
+}
+
+#if defined(COMPACTGRAPH_SIMD)
+// Compare blocks of four values of each list, all pairs at once, and advance the block with the smallest last
+// value. The lists must be strictly increasing. On return i and j point to the first values not yet merged.
+__attribute__((target("avx2")))
+static size_t merge_avx2(const Input& in, const oid* left, const oid* right, size_t& i, size_t i_end, size_t& j, size_t j_end, const Output& out, size_t k){
+	while(i + 4 <= i_end && j + 4 <= j_end){
+		__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + j));
+		// the lane l of the rotation r holds right[j + (l + r) % 4]
+		int m0 = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(va, vb)));
+		int m1 = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1)))));
+		int m2 = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(1, 0, 3, 2)))));
+		int m3 = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+		int matches = m0 | m1 | m2 | m3;
+		while(matches){
+			int l = __builtin_ctz(matches);
+			int r = (m1 >> l) & 1 ? 1 : (m2 >> l) & 1 ? 2 : (m3 >> l) & 1 ? 3 : 0;
+			out.emit(in, i + l, j + ((l + r) & 3), k++);
+			matches &= matches -1;
+		}
+
+		oid l = left[i +3], r = right[j +3];
+		if(l <= r) i += 4;
+		if(r <= l) j += 4;
+	}
+	return k;
+}
+#endif
+
+// Merge a part of the candidate lists, dispatching on their layout
+static size_t merge(const Input& in, size_t i, size_t i_end, size_t j, size_t j_end, const Output& out, size_t k){
+	const oid* left = in.left.data();
+	const oid* right = in.right.data();
+	if(left != nullptr && right != nullptr){
+#if defined(COMPACTGRAPH_SIMD)
+		if(in.keyed && simd::level() != simd::Level::none){
+			k = merge_avx2(in, left, right, i, i_end, j, j_end, out, k);
+		}
+#endif
+		return merge_scalar(in, left, right, i, i_end, j, j_end, out, k);
+	} else if(left != nullptr){
+		return merge_scalar(in, left, in.right, i, i_end, j, j_end, out, k);
+	} else if(right != nullptr){
+		return merge_scalar(in, in.left, right, i, i_end, j, j_end, out, k);
+	} else {
+		return merge_scalar(in, in.left, in.right, i, i_end, j, j_end, out, k);
+	}
+}
+
+// Split left[i, left_sz) and right[j, right_sz) into the given number of parts with about the same number of
+// candidates, along the merge path. The bounds are moved to the first occurrence of a value, so that equal
+// values of both lists end up in the same part. Return the bounds <i, j> of each part.
+static vector<pair<size_t, size_t>> merge_path(const Input& in, size_t i, size_t j, size_t num_parts){
+	const size_t left_sz = in.left_sz - i, right_sz = in.right_sz - j;
+	vector<pair<size_t, size_t>> bounds { {i, j} };
+	for(size_t p = 1; p < num_parts; p++){
+		// intersect the merge path with the diagonal
+		size_t diagonal = p * (left_sz + right_sz) / num_parts;
+		size_t lo = diagonal > right_sz ? diagonal - right_sz : 0, hi = min(diagonal, left_sz);
+		while(lo < hi){
+			size_t mid = lo + (hi - lo) / 2;
+			if(in.left[i + mid] <= in.right[j + diagonal - mid -1]) lo = mid +1; else hi = mid;
+		}
+		size_t x = i + lo, y = j + diagonal - lo;
+
+		// align to the first occurrence of the next value
+		oid value = x < in.left_sz ? in.left[x] : in.right[y];
+		if(x < in.left_sz && y < in.right_sz) value = min(in.left[x], in.right[y]);
+		x = lower_bound(in.left, bounds.back().first, in.left_sz, value);
+		y = lower_bound(in.right, bounds.back().second, in.right_sz, value);
+		bounds.emplace_back(x, y);
+	}
+	bounds.emplace_back(in.left_sz, in.right_sz);
+	return bounds;
+}
+
+// Intersect sorted candidate lists, whose first `prefix' values are equal. Return the number of matches.
+static size_t intersect_sorted(const Input& in, size_t prefix, const Output& out){
+	copy_values(in.left, 0, prefix, out.candidates);
+	copy_values(in.src, 0, prefix, out.src);
+	copy_values(in.dst, 0, prefix, out.dst);
+
+	size_t total = (in.left_sz - prefix) + (in.right_sz - prefix);
+	size_t num_parts = max<size_t>(1, min(num_threads(), total / INTERJOIN_MIN_PARALLEL));
+	if(num_parts == 1){
+		return merge(in, prefix, in.left_sz, prefix, in.right_sz, out, prefix);
+	}
+
+	// each part writes its matches after the room reserved to the previous ones, the number of matches of a
+	// part is bounded by its shortest list
+	auto bounds = merge_path(in, prefix, prefix, num_parts);
+	vector<size_t> offsets(num_parts +1, prefix), ends(num_parts);
+	for(size_t p = 0; p < num_parts; p++){
+		size_t left_sz = bounds[p +1].first - bounds[p].first, right_sz = bounds[p +1].second - bounds[p].second;
+		offsets[p +1] = offsets[p] + min(left_sz, right_sz);
+	}
+	parallel_for(num_parts, [&](size_t p){
+		ends[p] = merge(in, bounds[p].first, bounds[p +1].first, bounds[p].second, bounds[p +1].second, out, offsets[p]);
+	});
+
+	// compact
+	size_t k = ends[0];
+	for(size_t p = 1; p < num_parts; p++){
+		size_t n = ends[p] - offsets[p];
+		memmove(out.candidates + k, out.candidates + offsets[p], n * sizeof(oid));
+		memmove(out.src + k, out.src + offsets[p], n * sizeof(oid));
+		memmove(out.dst + k, out.dst + offsets[p], n * sizeof(oid));
+		k += n;
+	}
+	return k;
+}
+
+/******************************************************************************
+ *                                                                            *
+ *   Hash join of the unsorted candidates                                     *
+ *                                                                            *
+ ******************************************************************************/
+
+#if defined(GRAPHinterjoinlist_SORT)
+// Intersect the candidate lists when at least one of them is not sorted. The hash table is built on the unsorted
+// list and probed in the order of the sorted one, so that the matches are already sorted. If neither is sorted,
+// only the matches are sorted at the end. Return the number of matches.
+static size_t intersect_unsorted(const Input& in, bool left_sorted, bool right_sorted, const Output& out){
+	size_t k = 0;
+	if(right_sorted || (!left_sorted && in.right_sz < in.left_sz)){ // build on the left
+		HashTable table(in.left, in.left_sz);
+		for(size_t j = 0, i = 0; j < in.right_sz; j++){
+			if(table.take(in.right[j], i)) out.emit(in, i, j, k++);
+		}
+	} else { // build on the right
+		HashTable table(in.right, in.right_sz);
+		for(size_t i = 0, j = 0; i < in.left_sz; i++){
+			if(table.take(in.left[i], j)) out.emit(in, i, j, k++);
+		}
+	}
+
+	if(!left_sorted && !right_sorted){
+		struct Match { oid candidate, src, dst; };
+		vector<Match> matches(k);
+		for(size_t m = 0; m < k; m++) matches[m] = Match{ out.candidates[m], out.src[m], out.dst[m] };
+		sort(matches.begin(), matches.end(), [](const Match& m1, const Match& m2){ return m1.candidate < m2.candidate; });
+		for(size_t m = 0; m < k; m++){
+			out.candidates[m] = matches[m].candidate;
+			out.src[m] = matches[m].src;
+			out.dst[m] = matches[m].dst;
+		}
+	}
+
+	return k;
+}
+#endif
+
+/******************************************************************************
+ *                                                                            *
+ *   MonetDB interface                                                        *
+ *                                                                            *
+ ******************************************************************************/
+
+static BatHandle acquire(bat* id){
+	BatHandle handle { id };
+	MAL_ASSERT_MSG(handle.type() == TYPE_oid, ILLEGAL_ARGUMENT, "Expected a column of oids");
+	return handle;
+}
+
+static BatHandle new_column(size_t capacity){
+	BatHandle output { COLnew(0, TYPE_oid, capacity, TRANSIENT) };
+	MAL_ASSERT(output.initialised(), MAL_MALLOC_FAIL);
+	return output;
+}
+
+static void set_count(BatHandle& column, size_t count, bool sorted, bool key, bool nonil){
+	BAT* b = column.get();
+	BATsetcount(b, count);
+	b->tsorted = sorted || count <= 1;
+	b->trevsorted = count <= 1;
+	b->tkey = key || count <= 1;
+	b->tnonil = nonil; b->tnil = 0;
+}
+
+extern "C" {
+
+/**
+ * Intersect the candidate lists a (left) and b (right), keeping the edges c (aligned with a) and d (aligned with b)
+ * of the matches. Equal candidates are paired one to one. If the lists are equal, the inputs are returned as
+ * they are.
+ */
+str GRAPHinterjoinlist(bat* out_candidates, bat* out_edge_src, bat* out_edge_dst,
+		bat* in_a, bat* in_b, bat* in_c, bat* in_d) noexcept {
+	const char* function_name = "graph.intersect_join_lists";
+
+	try {
+		BatHandle a = acquire(in_a), b = acquire(in_b), c = acquire(in_c), d = acquire(in_d);
+		MAL_ASSERT_MSG(a.size() == c.size() && b.size() == d.size(), ILLEGAL_ARGUMENT, "The edges are not aligned with the candidates");
+		const bool left_sorted = a.dense() || a.get()->tsorted;
+		const bool right_sorted = b.dense() || b.get()->tsorted;
+#if !defined(GRAPHinterjoinlist_SORT)
+		// at this point both input should be sorted
+		MAL_ASSERT_MSG(left_sorted && right_sorted, ILLEGAL_ARGUMENT, "The candidate lists are not sorted");
+#endif
+
+		Input in { a.oids(), b.oids(), c.oids(), d.oids(), a.size(), b.size(),
+			(a.dense() || a.get()->tkey) && (b.dense() || b.get()->tkey) };
+
+		// skip the equal values at the begin
+		size_t prefix = 0;
+		const size_t min_sz = min(in.left_sz, in.right_sz);
+		if(in.left.dense() && in.right.dense()){
+			prefix = in.left[0] == in.right[0] ? min_sz : 0;
+		} else {
+			while(prefix < min_sz && in.left[prefix] == in.right[prefix]) prefix++;
+		}
+
+		if(prefix == in.left_sz && prefix == in.right_sz){ // no changes, keep the same input
+			*out_candidates = a.release_logical();
+			*out_edge_src = c.release_logical();
+			*out_edge_dst = d.release_logical();
+			return MAL_SUCCEED;
+		}
+
+		BatHandle candidates = new_column(min_sz), edge_src = new_column(min_sz), edge_dst = new_column(min_sz);
+		Output out { candidates.array<oid>(), edge_src.array<oid>(), edge_dst.array<oid>() };
+		size_t count = 0;
+#if defined(GRAPHinterjoinlist_SORT)
+		if(!left_sorted || !right_sorted){
+			count = intersect_unsorted(in, left_sorted, right_sorted, out);
+		} else
+#endif
+		count = intersect_sorted(in, prefix, out);
+
+		bool key = (a.dense() || a.get()->tkey) || (b.dense() || b.get()->tkey);
+		bool nonil = (a.dense() || a.get()->tnonil) || (b.dense() || b.get()->tnonil);
+		set_count(candidates, count, true, key, nonil);
+		set_count(edge_src, count, false, false, c.dense() || c.get()->tnonil);
+		set_count(edge_dst, count, false, false, d.dense() || d.get()->tnonil);
+
+		*out_candidates = candidates.release_logical();
+		*out_edge_src = edge_src.release_logical();
+		*out_edge_dst = edge_dst.release_logical();
+	} catch(gr8::Exception& e){
+		return handle_exception(function_name, e);
+	} catch(std::bad_alloc& b){
+		return createException(MAL, function_name, MAL_MALLOC_FAIL);
+	} catch(...){
+		return createException(MAL, function_name, OPERATION_FAILED);
+	}
+
+	return MAL_SUCCEED;
+}
+
+} // extern "C"
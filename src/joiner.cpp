@@ -16,11 +16,16 @@
 
 using namespace gr8;
 
+// Append a value to the given column of oids
+static void append(BAT* b, oid value){
+	BUNappend(b, &value, false);
+}
+
 Joiner::Joiner(Query& q) : query(q),
-		cl0(q.candidates_left.array<oid>()),
-		cr0(q.is_join_semantics()?q.candidates_right.array<oid>():nullptr),
-		el0(q.query_src.array<oid>()),
-		er0(q.query_dst.array<oid>()),
+		cl0(q.candidates_left.oids()),
+		cr0(q.is_join_semantics()?q.candidates_right.oids():OidColumn{nullptr, 0}),
+		el0(q.query_src.oids()),
+		er0(q.query_dst.oids()),
 		changes(false), finalized(false), is_join_semantics(q.is_join_semantics()), last(0), multiple_aggregates(query.shortest_paths.size() > 1) {
 	if(is_join_semantics){
 		initchg();
@@ -52,7 +57,7 @@ void Joiner::initchg(){
 
 		BAT* bat_cl = jl.get();
 		for(size_t i = 0; i < last; i++){
-			BUNappend(bat_cl, cl0 + i, false);
+			append(bat_cl, cl0[i]);
 		}
 
 		if(multiple_aggregates){
@@ -60,8 +65,8 @@ void Joiner::initchg(){
 			BAT* bat_er = er.get();
 
 			for(size_t i = 0; i < last; i++){
-				BUNappend(bat_el, el0 + i, false);
-				BUNappend(bat_er, er0 + i, false);
+				append(bat_el, el0[i]);
+				append(bat_er, er0[i]);
 			}
 		}
 	}
@@ -80,20 +85,19 @@ void Joiner::join(oid i, oid j){
 		i = j;
 		if(j == last && !changes){
 			last++;
-		} else {
+		} else if(!changes){
 			initchg(); // set `changes' to true
 		}
 	}
 
 	if(changes){
-		BUNappend(jl.get(), cl0 + i, false);
+		append(jl.get(), cl0[i]);
 		if(is_join_semantics){
-			assert(cr0 != nullptr);
-			BUNappend(jr.get(), cr0 + j, false);
+			append(jr.get(), cr0[j]);
 		}
 		if(multiple_aggregates){
-			BUNappend(el.get(), el0 + i, false);
-			BUNappend(er.get(), er0 + j, false);
+			append(el.get(), el0[i]);
+			append(er.get(), er0[j]);
 		}
 	}
 }
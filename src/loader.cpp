@@ -0,0 +1,341 @@
+/*
+ * loader.cpp
+ * Text loaders for graph.load and graph.loadq. The file is mapped in memory, split into chunks aligned to the
+ * lines and parsed in parallel, each thread into its own buffers, which are then copied into the output BATs.
+ *
+ * Accepted formats, detected from the content of the file:
+ * - plain: one edge per line <from> <to> [<weight>], as produced by graphgen or a SNAP edge list, with comments
+ *   starting with '#' or '%'. A missing weight is 1;
+ * - DIMACS: edges `a <from> <to> <weight>' (.gr) or queries `q <from> <to>' (.p2p), comments `c' and problem
+ *   lines `p' are skipped;
+ * - Matrix Market: coordinate matrices of type `integer' or `pattern', general or symmetric. A symmetric matrix
+ *   generates the edges in both directions.
+ * The vertices of DIMACS and Matrix Market files are 1-based, they are shifted to 0-based.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bat_handle.hpp"
+#include "errorhandling.hpp"
+#include "monetdb_config.hpp"
+#include "parallel.hpp"
+
+using namespace gr8;
+using namespace std;
+
+// Do not split the input in chunks smaller than this size, in bytes
+static constexpr size_t LOADER_MIN_CHUNK_SIZE = 1ull << 20; // arbitrary value
+
+namespace {
+
+enum class Format { plain, dimacs, matrix_market };
+
+// Where and how to parse the records of a file
+struct Layout {
+	Format format = Format::plain;
+	const char* file = nullptr; // first byte of the file, for the offsets in the errors
+	const char* begin = nullptr; // first byte after the headers
+	const char* end = nullptr;
+	bool symmetric = false; // Matrix Market only
+	bool weighted = true; // idem, false for the pattern matrices
+};
+
+// Columns parsed by a single thread
+struct Records {
+	vector<oid> src;
+	vector<oid> dst;
+	vector<lng> weights; // edges only
+
+	void append(oid from, oid to, lng weight, bool edges){
+		src.push_back(from);
+		dst.push_back(to);
+		if(edges) weights.push_back(weight);
+	}
+};
+
+// A read-only file mapped in memory
+class MappedFile {
+	int fd = -1;
+	char* data = nullptr;
+	size_t length = 0;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+public:
+	MappedFile(const char* path){
+		fd = open(path, O_RDONLY);
+		MAL_ASSERT(fd >= 0, RUNTIME_FILE_NOT_FOUND);
+		struct stat info;
+		if(fstat(fd, &info) != 0){ close(fd); MAL_ERROR(RUNTIME_STREAM_INPUT, "Cannot stat the file: " << path); }
+		length = info.st_size;
+		if(length == 0) return; // mmap does not accept empty mappings
+		void* ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(ptr == MAP_FAILED){ close(fd); MAL_ERROR(RUNTIME_STREAM_INPUT, "Cannot map the file: " << path); }
+		data = (char*) ptr;
+		madvise(data, length, MADV_WILLNEED);
+	}
+
+	~MappedFile(){
+		if(data != nullptr) munmap(data, length);
+		if(fd >= 0) close(fd);
+	}
+
+	const char* begin() const { return data; }
+	const char* end() const { return data + length; }
+};
+
+} // anonymous namespace
+
+static bool is_blank(char c){
+	return c == ' ' || c == '\t';
+}
+
+static bool is_eol(char c){
+	return c == '\n' || c == '\r';
+}
+
+static const char* skip_blanks(const char* p, const char* end){
+	while(p < end && is_blank(*p)) p++;
+	return p;
+}
+
+static const char* next_line(const char* p, const char* end){
+	while(p < end && *p != '\n') p++;
+	return p < end ? p +1 : end;
+}
+
+// Parse an unsigned integer, in place of strtoll. Return false if there are no digits or the value does not fit
+// in 64 bits.
+static bool parse_uint(const char*& p, const char* end, uint64_t& value){
+	const char* start = p;
+	uint64_t result = 0;
+	while(p < end && (unsigned char) (*p - '0') < 10){
+		const uint64_t digit = *p - '0';
+		if(result > (UINT64_MAX - digit) / 10) return false; // overflow
+		result = result * 10 + digit;
+		p++;
+	}
+	value = result;
+	return p != start;
+}
+
+// Does the line at `p' start with the given token?
+static bool starts_with(const char* p, const char* end, const char* token){
+	size_t length = strlen(token);
+	return (size_t) (end - p) >= length && memcmp(p, token, length) == 0;
+}
+
+// Detect the format of the file and skip its headers
+static Layout detect_layout(const char* begin, const char* end){
+	Layout layout;
+	layout.file = begin;
+	layout.begin = begin;
+	layout.end = end;
+
+	const char* p = begin;
+	while(p < end && (is_blank(*p) || is_eol(*p))) p++;
+	if(p == end) return layout; // empty
+
+	if(starts_with(p, end, "%%MatrixMarket")){
+		layout.format = Format::matrix_market;
+		const char* eol = next_line(p, end);
+		string banner(p, eol);
+		transform(banner.begin(), banner.end(), banner.begin(), ::tolower);
+		MAL_ASSERT_MSG(banner.find("coordinate") != string::npos, RUNTIME_LOAD_ERROR, "Matrix Market: only coordinate matrices are supported");
+		MAL_ASSERT_MSG(banner.find("real") == string::npos && banner.find("complex") == string::npos, RUNTIME_LOAD_ERROR, "Matrix Market: only integer and pattern matrices are supported");
+		MAL_ASSERT_MSG(banner.find("skew") == string::npos && banner.find("hermitian") == string::npos, RUNTIME_LOAD_ERROR, "Matrix Market: only general and symmetric matrices are supported");
+		layout.symmetric = banner.find("symmetric") != string::npos;
+		layout.weighted = banner.find("pattern") == string::npos;
+
+		// skip the comments and the line with the size of the matrix
+		p = eol;
+		while(p < end){
+			const char* q = skip_blanks(p, end);
+			if(q < end && !is_eol(*q) && *q != '%'){ p = next_line(q, end); break; }
+			p = next_line(q, end);
+		}
+		layout.begin = p;
+	} else if (*p == 'c' || *p == 'p') {
+		layout.format = Format::dimacs;
+	}
+
+	return layout;
+}
+
+// Parse the records in [begin, end), starting at the beginning of a line. Queries only have the columns src and dst.
+static void parse_records(const Layout& layout, bool edges, const char* begin, const char* end, Records& out){
+	const bool shift = layout.format != Format::plain; // 1-based vertices
+	const char record_tag = edges ? 'a' : 'q'; // DIMACS
+
+	const char* p = begin;
+	while(p < end){
+		p = skip_blanks(p, end);
+		if(p == end) break;
+		char c = *p;
+		if(is_eol(c)){ p++; continue; }
+
+		// comments & headers
+		if(c == '#' || c == '%' || (layout.format == Format::dimacs && (c == 'c' || c == 'p'))){
+			p = next_line(p, end);
+			continue;
+		}
+		if(layout.format == Format::dimacs){
+			MAL_ASSERT_MSG(c == record_tag && p +1 < end && is_blank(p[1]), RUNTIME_LOAD_ERROR, "DIMACS: unexpected line at offset " << (p - layout.file));
+			p = skip_blanks(p +1, end);
+		}
+
+		uint64_t from = 0, to = 0, weight = 1;
+		const char* start = p;
+		bool valid = parse_uint(p, end, from);
+		p = skip_blanks(p, end);
+		valid = valid && parse_uint(p, end, to);
+		if(valid && edges && layout.weighted){
+			p = skip_blanks(p, end);
+			if(p < end && !is_eol(*p)){
+				valid = parse_uint(p, end, weight);
+			} else {
+				valid = layout.format == Format::plain; // optional only in the plain format
+			}
+		}
+		p = skip_blanks(p, end);
+		valid = valid && (p == end || is_eol(*p));
+		valid = valid && (!shift || (from > 0 && to > 0));
+		valid = valid && weight <= (uint64_t) INT64_MAX; // lng
+		MAL_ASSERT_MSG(valid, RUNTIME_LOAD_ERROR, "Invalid record at offset " << (start - layout.file));
+		if(shift){ from--; to--; }
+
+		out.append(from, to, (lng) weight, edges);
+		if(layout.symmetric && from != to){
+			out.append(to, from, (lng) weight, edges);
+		}
+
+		p = next_line(p, end);
+	}
+}
+
+// Split [begin, end) into chunks aligned to the lines, one for each thread
+static vector<const char*> split_chunks(const char* begin, const char* end){
+	size_t length = end - begin;
+	size_t num_threads = max<size_t>(1, min(gr8::num_threads(), length / LOADER_MIN_CHUNK_SIZE));
+
+	vector<const char*> bounds { begin };
+	for(size_t i = 1; i < num_threads; i++){
+		const char* p = max(begin + i * length / num_threads, bounds.back());
+		bounds.push_back(p == begin ? p : next_line(p -1, end));
+	}
+	bounds.push_back(end);
+	return bounds;
+}
+
+static BatHandle new_column(int type, size_t count){
+	BatHandle output { COLnew(0, type, count, TRANSIENT) };
+	MAL_ASSERT(output.initialised(), MAL_MALLOC_FAIL);
+	BAT* b = output.get();
+	BATsetcount(b, count);
+	b->tsorted = b->trevsorted = b->tkey = count <= 1;
+	b->tnonil = 1; b->tnil = 0;
+	return output;
+}
+
+// Load the edges (from, to, weights) or the queries (from, to) of the given file
+static void load(const char* path, bool edges, BatHandle& out_src, BatHandle& out_dst, BatHandle* out_weights){
+	MappedFile file(path);
+	Layout layout = detect_layout(file.begin(), file.end());
+
+	// parse
+	vector<const char*> bounds = split_chunks(layout.begin, layout.end);
+	const size_t num_chunks = bounds.size() -1;
+	vector<Records> records(num_chunks);
+	parallel_for(num_chunks, [&](size_t i){
+		parse_records(layout, edges, bounds[i], bounds[i +1], records[i]);
+	});
+
+	// concatenate
+	vector<size_t> offsets(num_chunks +1, 0);
+	for(size_t i = 0; i < num_chunks; i++){
+		offsets[i +1] = offsets[i] + records[i].src.size();
+	}
+	const size_t count = offsets.back();
+	out_src = new_column(TYPE_oid, count);
+	out_dst = new_column(TYPE_oid, count);
+	if(edges) *out_weights = new_column(TYPE_lng, count);
+	oid* src = out_src.array<oid>();
+	oid* dst = out_dst.array<oid>();
+	lng* weights = edges ? out_weights->array<lng>() : nullptr;
+	parallel_for(num_chunks, [&](size_t i){
+		Records& r = records[i];
+		copy(r.src.begin(), r.src.end(), src + offsets[i]);
+		copy(r.dst.begin(), r.dst.end(), dst + offsets[i]);
+		if(edges) copy(r.weights.begin(), r.weights.end(), weights + offsets[i]);
+		r = Records{}; // release the memory
+	});
+}
+
+
+/******************************************************************************
+ *                                                                            *
+ *   MonetDB interface                                                        *
+ *                                                                            *
+ ******************************************************************************/
+extern "C" {
+
+// Load a graph into the three bats <from, to, weight>
+str GRAPHload(bat* ret_id_from, bat* ret_id_to, bat* ret_id_weights, str* path) noexcept {
+	const char* function_name = "graph.load";
+
+	try {
+		BatHandle from, to, weights;
+		load(*path, /* edges = */ true, from, to, &weights);
+
+		*ret_id_from = from.release_logical();
+		*ret_id_to = to.release_logical();
+		*ret_id_weights = weights.release_logical();
+	} catch(gr8::Exception& e){
+		return handle_exception(function_name, e);
+	} catch(std::bad_alloc& b){
+		return createException(MAL, function_name, MAL_MALLOC_FAIL);
+	} catch(...){
+		return createException(MAL, function_name, OPERATION_FAILED);
+	}
+
+	return MAL_SUCCEED;
+}
+
+// Load a set of queries <from, to>
+str GRAPHloadq(bat* ret_id_qfrom, bat* ret_id_qto, str* path) noexcept {
+	const char* function_name = "graph.loadq";
+
+	try {
+		BatHandle qfrom, qto;
+		load(*path, /* edges = */ false, qfrom, qto, nullptr);
+
+		// set the bats as read-only. As we are going to scatter them with BATslice, this will allow
+		// to create views instead of full partitioned copies
+		qfrom.get()->S.restricted = BAT_READ;
+		qto.get()->S.restricted = BAT_READ;
+
+		*ret_id_qfrom = qfrom.release_logical();
+		*ret_id_qto = qto.release_logical();
+	} catch(gr8::Exception& e){
+		return handle_exception(function_name, e);
+	} catch(std::bad_alloc& b){
+		return createException(MAL, function_name, MAL_MALLOC_FAIL);
+	} catch(...){
+		return createException(MAL, function_name, OPERATION_FAILED);
+	}
+
+	return MAL_SUCCEED;
+}
+
+} // extern "C"
@@ -13,34 +13,147 @@
 // Graph library includes
 #include "debug.h"
 
+// Number of neighbours of a source sampled to estimate the cost of its search
+#define SLICER_SAMPLE_SZ 64 // arbitrary value
+
+// Value at the position pos of a column of oids, also when it is dense (TYPE_void)
+static oid slicer_get(BAT* b, BUN pos){
+	return b->T.type == TYPE_void ? b->T.seq + pos : *((oid*) Tloc(b, pos));
+}
+
+// Out-degree of a vertex in the compact graph <vertices, edges>, as built by graph.make
+static BUN slicer_degree(BAT* vertices, oid vertex){
+	if(vertex >= BATcount(vertices)) return 0; // no outgoing edges
+	return slicer_get(vertices, vertex) - (vertex == 0 ? 0 : slicer_get(vertices, vertex -1));
+}
+
+// Estimate of the work of a search from the given source: the edges within two hops, where the second hop is
+// extrapolated from a sample of the neighbours
+static double slicer_cost(BAT* vertices, BAT* edges, oid source){
+	BUN degree = slicer_degree(vertices, source);
+	BUN begin = 0, num_samples = 0, sum = 0;
+
+	if(degree == 0) return 1;
+	begin = source == 0 ? 0 : slicer_get(vertices, source -1);
+	num_samples = degree < SLICER_SAMPLE_SZ ? degree : SLICER_SAMPLE_SZ;
+	for(BUN i = 0; i < num_samples; i++){
+		sum += slicer_degree(vertices, slicer_get(edges, begin + i * (degree / num_samples)));
+	}
+
+	return 1 + degree + ((double) sum) * degree / num_samples;
+}
+
+// Bounds of partitions with an equal number of tuples, extended to the end of a run of equal sources if `src' is given
+static void slicer_bounds_equal(BUN* bounds, BUN num_partitions, BUN input_sz, BAT* src /* nullable */){
+	BUN step_sz = ceil(((double) input_sz) / num_partitions);
+	bounds[0] = 0;
+	for(BUN i = 1; i <= num_partitions; i++){
+		BUN high = i * step_sz;
+		if(high < bounds[i -1]) high = bounds[i -1]; // the previous partition went past this point
+		if(high > input_sz) high = input_sz;
+		if(src != NULL){ // do not split the run of a source
+			for( ; high > 0 && high < input_sz && slicer_get(src, high) == slicer_get(src, high -1); high++);
+		}
+		bounds[i] = high;
+	}
+}
+
+// Bounds of partitions with an equal estimated work, a run of equal sources costs a single search
+static str slicer_bounds_balanced(const char* function_name, BUN* bounds, BUN num_partitions, BUN input_sz, BAT* src, BAT* vertices, BAT* edges){
+	str rc = MAL_SUCCEED;
+	double* costs = NULL; // costs[i] is the total cost of the runs before the position i, at the end of each run
+	double total = 0;
+	BUN run_end = 0;
+
+	costs = GDKmalloc((input_sz +1) * sizeof(double));
+	CHECK(costs != NULL, MAL_MALLOC_FAIL);
+	costs[0] = 0;
+	for(BUN i = 0; i < input_sz; i = run_end){
+		oid source = slicer_get(src, i);
+		for(run_end = i +1; run_end < input_sz && slicer_get(src, run_end) == source; run_end++){
+			costs[run_end] = total; // inside the run, never a bound
+		}
+		total += slicer_cost(vertices, edges, source) + (run_end - i); // the search and its pairs
+		costs[run_end] = total;
+	}
+
+	// split the remaining cost evenly among the remaining partitions, at the end of the run closest to the split
+	// point. A partition takes at least one run, a costly source ends up alone rather than with an empty partition
+	bounds[0] = 0;
+	for(BUN i = 1; i < num_partitions; i++){
+		BUN high = bounds[i -1];
+		double target = costs[high] + (total - costs[high]) / (num_partitions - i +1);
+		while(high < input_sz){
+			BUN next = high +1;
+			for( ; next < input_sz && slicer_get(src, next) == slicer_get(src, next -1); next++);
+			if(costs[next] >= target){
+				if(high == bounds[i -1] || costs[next] - target < target - costs[high]) high = next;
+				break;
+			}
+			high = next;
+		}
+		bounds[i] = high;
+	}
+	bounds[num_partitions] = input_sz;
+
+error:
+	if(costs) { GDKfree(costs); }
+	return rc;
+}
+
 /*
- * Split the given input BAT into multiple bats of equal sizes. The number of BATs that should be created
- * is defined by the number of variables expected in the output
+ * Split the input BATs into the number of partitions given by the number of variables expected in the output,
+ * divided by the number of inputs. The outputs are grouped by partition: (a0, b0, a1, b1, ...) := graph.slicer(a, b).
+ * With more than one input, the first one is the source of the queries and a partition is never cut between
+ * two equal values of it, so that the searches of a source are not repeated in multiple partitions. The slices
+ * are views over the inputs when these are read-only, as produced by graph.loadq.
+ * With `balanced' set, the first two inputs are the compact graph <vertices, edges> from graph.make, and the
+ * partitions are balanced by the estimated cost of their searches, rather than by their number of tuples.
  */
-mal_export str
-GRAPHslicer(void* cntxt, MalBlkPtr mb, MalStkPtr stk, InstrPtr p){
-	const char* function_name = "graph.slicer";
+static str
+slicer(const char* function_name, MalBlkPtr mb, MalStkPtr stk, InstrPtr p, bool balanced){
 	str rc = MAL_SUCCEED;
-	BAT* input = NULL;
-	bte input_type;
-	BUN num_partitions, input_sz, step_sz;
-	BUN pstart; // start of the current partition
+	const BUN num_graph_args = balanced ? 2 : 0;
+	BAT *vertices = NULL, *edges = NULL;
+	BAT** inputs = NULL;
+	BUN num_inputs = 0, num_partitions = 0;
+	BUN* bounds = NULL; // the partition i is [bounds[i], bounds[i+1])
 	BAT** container = NULL;
 
 	// validate input parameters
 	CHECK(p->argc >= 2, ILLEGAL_ARGUMENT ": Wrong number of arguments (< 2)");
 	CHECK(p->retc >= 1, ILLEGAL_ARGUMENT ": Expected at least one return parameter");
-	CHECK(p->argc - p->retc == 1, ILLEGAL_ARGUMENT ": Expected exactly one input parameter");
+	CHECK((BUN) (p->argc - p->retc) > num_graph_args, ILLEGAL_ARGUMENT ": Expected at least one input parameter");
+	num_inputs = p->argc - p->retc - num_graph_args;
+	CHECK(p->retc % num_inputs == 0, ILLEGAL_ARGUMENT ": The number of outputs is not a multiple of the number of inputs");
+	num_partitions = p->retc / num_inputs;
+
+	// retrieve the graph
+	if(balanced){
+		vertices = BATdescriptor(*((bat*)getArgReference(stk, p, p->retc)));
+		CHECK(vertices != NULL, RUNTIME_OBJECT_MISSING);
+		edges = BATdescriptor(*((bat*)getArgReference(stk, p, p->retc +1)));
+		CHECK(edges != NULL, RUNTIME_OBJECT_MISSING);
+		CHECK(ATOMtype(vertices->T.type) == TYPE_oid && ATOMtype(edges->T.type) == TYPE_oid, ILLEGAL_ARGUMENT ": Expected the columns of graph.make");
+		CHECK(BATcount(vertices) == 0 || slicer_get(vertices, BATcount(vertices) -1) == BATcount(edges), ILLEGAL_ARGUMENT ": The offsets do not match the number of edges");
+	}
 
-	// retrieve the input
-	input = BATdescriptor(*((bat*)getArgReference(stk, p, p->retc)));
-	CHECK(input != NULL, RUNTIME_OBJECT_MISSING);
-	input_type = ATOMtype(input->T.type);
+	// retrieve the inputs
+	// MonetDB defines its own version of calloc
+	inputs = calloc(num_inputs, sizeof(BAT*));
+	CHECK(inputs != NULL, MAL_MALLOC_FAIL);
+	for(BUN j = 0; j < num_inputs; j++){
+		inputs[j] = BATdescriptor(*((bat*)getArgReference(stk, p, p->retc + num_graph_args + j)));
+		CHECK(inputs[j] != NULL, RUNTIME_OBJECT_MISSING);
+		CHECK(BATcount(inputs[j]) == BATcount(inputs[0]), ILLEGAL_ARGUMENT ": The inputs have different sizes");
+	}
+	CHECK((num_inputs == 1 && !balanced) || ATOMtype(inputs[0]->T.type) == TYPE_oid, ILLEGAL_ARGUMENT ": Expected a column of oids as the source");
 
 	// check the types for the output bats is the same as the input
-	for(BUN i = 0; i < p->retc; i++){
+	for(BUN i = 0; i < (BUN) p->retc; i++){
 		int type = getArgType(mb, p, i);
 		int bat_type = -1;
+		bte input_type = ATOMtype(inputs[i % num_inputs]->T.type);
 
 		CHECK(isaBatType(type), ILLEGAL_ARGUMENT);
 		bat_type = getBatType(type);
@@ -51,50 +164,39 @@ GRAPHslicer(void* cntxt, MalBlkPtr mb, MalStkPtr stk, InstrPtr p){
 		}
 	}
 
-	// compute the size of the partitions
-	input_sz = BATcount(input);
-	num_partitions = p->retc;
-	step_sz = ceil(((double) input_sz) / num_partitions);
-	// MonetDB defines its own version of calloc
-	container = calloc(num_partitions, sizeof(BAT*));
+	// compute the bounds of the partitions
+	bounds = calloc(num_partitions +1, sizeof(BUN));
+	CHECK(bounds != NULL, MAL_MALLOC_FAIL);
+	if(balanced){
+		rc = slicer_bounds_balanced(function_name, bounds, num_partitions, BATcount(inputs[0]), inputs[0], vertices, edges);
+		if(rc != MAL_SUCCEED) goto error;
+	} else {
+		slicer_bounds_equal(bounds, num_partitions, BATcount(inputs[0]), num_inputs > 1 ? inputs[0] : NULL);
+	}
 
 	// Create the slices
-	pstart = 0;
+	container = calloc(p->retc, sizeof(BAT*));
+	CHECK(container != NULL, MAL_MALLOC_FAIL);
 	for(BUN i = 0; i < num_partitions; i++){
-		BUN low = pstart;
-		BUN high = low + step_sz;
-		BAT* slice = container[i] = BATslice(input, low, high);
-//		bat_debug(slice);
-		CHECK(slice != NULL, MAL_MALLOC_FAIL);
-		slice->hseqbase = 0; // reset the partition no.
-
-		if(slice->T.type == TYPE_void){
-			 // the output has type TYPE_void, materialize as TYPE_oid
-			oid value = slice->T.seq;
-			const size_t matslice_sz = BATcount(slice);
-			BAT* matslice = COLnew(0, TYPE_oid, matslice_sz, TRANSIENT);
-			oid* valarray = NULL;
-
-			CHECK(matslice != NULL, MAL_MALLOC_FAIL);
-			valarray = (oid*) matslice->T.heap.base;
-
-			for(size_t j = 0; j < matslice_sz; j++){
-				valarray[j] = value;
-				value++;
-			}
-			BATsetcount(matslice, matslice_sz);
-
-			container[i] = matslice;
-			BBPunfix(slice->batCacheid);
+		for(BUN j = 0; j < num_inputs; j++){
+			BAT* slice = container[i * num_inputs + j] = BATslice(inputs[j], bounds[i], bounds[i +1]);
+//			bat_debug(slice);
+			CHECK(slice != NULL, MAL_MALLOC_FAIL);
+			slice->hseqbase = 0; // reset the partition no.
+			// a slice of a dense (TYPE_void) input is still dense, the operators read it without materialising it
 		}
-
-		pstart = high; // next iteration
 	}
 
-	BATfree(input);
+	BATfree(vertices);
+	BATfree(edges);
+	for(BUN j = 0; j < num_inputs; j++){
+		BATfree(inputs[j]);
+	}
+	free(inputs);
+	free(bounds);
 
 	// Return the slices
-	for(BUN i = 0; i < num_partitions; i++){
+	for(BUN i = 0; i < (BUN) p->retc; i++){
 //		bat_debug(container[i]);
 		BBPkeepref(container[i]->batCacheid);
 		stk->stk[p->argv[i]].val.bval = container[i]->batCacheid;
@@ -104,10 +206,18 @@ GRAPHslicer(void* cntxt, MalBlkPtr mb, MalStkPtr stk, InstrPtr p){
 
 	return rc;
 error:
-	BATfree(input);
+	BATfree(vertices);
+	BATfree(edges);
+	if(inputs){
+		for(BUN j = 0; j < num_inputs; j++){
+			BATfree(inputs[j]);
+		}
+		free(inputs);
+	}
+	free(bounds);
 
 	if(container){
-		for(BUN i = 0; i < num_partitions; i++){
+		for(BUN i = 0; i < (BUN) p->retc; i++){
 			BATfree(container[i]);
 		}
 		free(container);
@@ -115,3 +225,15 @@ error:
 
 	return rc;
 }
+
+mal_export str
+GRAPHslicer(void* cntxt, MalBlkPtr mb, MalStkPtr stk, InstrPtr p){
+	(void) cntxt;
+	return slicer("graph.slicer", mb, stk, p, false);
+}
+
+mal_export str
+GRAPHslicer_balanced(void* cntxt, MalBlkPtr mb, MalStkPtr stk, InstrPtr p){
+	(void) cntxt;
+	return slicer("graph.slicer_balanced", mb, stk, p, true);
+}
@@ -0,0 +1,50 @@
+/*
+ * parallel.hpp
+ * Minimal helpers to run a loop on multiple threads.
+ */
+
+#ifndef PARALLEL_HPP_
+#define PARALLEL_HPP_
+
+#include <cstddef>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "monetdb_config.hpp"
+
+namespace gr8 {
+
+// Number of threads available to an operator, as configured in the GDK
+inline std::size_t num_threads(){
+	return GDKnr_threads > 0 ? (std::size_t) GDKnr_threads : std::thread::hardware_concurrency();
+}
+
+// Run fn(i) for i in [0, n), each on a different thread, and rethrow the first exception raised
+template<typename Function>
+void parallel_for(std::size_t n, Function fn){
+	std::vector<std::exception_ptr> errors(n);
+	auto run = [&errors, &fn](std::size_t i){
+		try { fn(i); } catch(...) { errors[i] = std::current_exception(); }
+	};
+
+	std::vector<std::thread> threads;
+	for(std::size_t i = 1; i < n; i++){
+		try {
+			threads.emplace_back(run, i);
+		} catch(std::system_error&){ // cannot spawn more threads, run it in the current one
+			run(i);
+		}
+	}
+	run(0);
+	for(auto& t : threads) t.join();
+
+	for(auto& e : errors){
+		if(e) std::rethrow_exception(e);
+	}
+}
+
+} /* namespace gr8 */
+
+#endif /* PARALLEL_HPP_ */
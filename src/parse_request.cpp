@@ -6,10 +6,15 @@
  */
 #include "parse_request.hpp"
 
-#include <cstdlib> // getenv
 #include <iostream> // cout
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "configuration.hpp"
 #include "third-party/tinyxml2.hpp"
 
 using namespace std;
@@ -92,18 +97,53 @@ static void parse_columns(XMLElement* parent, ParseExpectedColumn* columns) {
 }
 
 
-static void parse_shortest_path(Query& query, MalStkPtr stackPtr, InstrPtr instrPtr, XMLElement* xml_shortest_path){
+namespace {
+	// Positions of the arguments referred by a request, independent of the actual arguments of a call
+	struct RequestPlan {
+		struct ShortestPathPlan {
+			int pos_weights; // -1 for a BFS
+			int pos_cost;
+			int pos_path; // -1 if the path is not required
+			lng bound; // -1 if unbounded
+		};
+
+		OperationType operation = op_invalid;
+		bool has_input = false;
+		int pos_candidates_left = -1;
+		int pos_candidates_right = -1;
+		int pos_src = -1;
+		int pos_dst = -1;
+		bool has_graph = false;
+		GraphDescriptorType graph_type = e_graph_columns;
+		int pos_graph_src = -1;
+		int pos_graph_dst = -1;
+		int pos_graph_mask = -1; // e_graph_columns only, optional
+		int pos_graph_id = -1; // e_graph_compact only
+		int pos_graph_count = -1; // idem
+		vector<ShortestPathPlan> shortest_paths;
+		bool has_output = false;
+		int pos_output_left = -1;
+		int pos_output_right = -1;
+	};
+}
+
+// Max number of compiled requests retained
+static constexpr size_t PLAN_CACHE_SIZE = 64; // arbitrary value
+
+static RequestPlan::ShortestPathPlan parse_shortest_path(XMLElement* xml_shortest_path){
 	CHECK(xml_shortest_path != nullptr, "XML ERROR: the node is null");
 	string tag = xml_shortest_path->Name();
 	CHECK(tag == "shortest_path", "subexpr/ Invalid node: " << tag);
 
-	auto get_arg = [stackPtr, instrPtr](int index) {
-		CHECK(index >= 0 && index < instrPtr->argc, "Invalid argument position: " << index);
-		return (bat*) getArgReference(stackPtr, instrPtr, index);
-	};
-
 	int pos_in_weights = -1, pos_out_cost = -1, pos_out_path = -1;
 
+	// optional bounds on the cost or on the number of hops of the paths
+	int64_t max_cost = -1, max_hops = -1;
+	XMLError xml_rc = xml_shortest_path->QueryInt64Attribute("max_cost", &max_cost);
+	CHECK(xml_rc == XML_NO_ATTRIBUTE || (xml_rc == XML_SUCCESS && max_cost >= 0), "Invalid value for the attribute 'max_cost'");
+	xml_rc = xml_shortest_path->QueryInt64Attribute("max_hops", &max_hops);
+	CHECK(xml_rc == XML_NO_ATTRIBUTE || (xml_rc == XML_SUCCESS && max_hops >= 0), "Invalid value for the attribute 'max_hops'");
+
 	XMLNode* base_node = xml_shortest_path->FirstChild();
 	do {
 		XMLElement* e = base_node->ToElement();
@@ -127,34 +167,15 @@ static void parse_shortest_path(Query& query, MalStkPtr stackPtr, InstrPtr instr
 	} while ( (base_node = base_node->NextSibling()) != nullptr );
 
 	CHECK(pos_out_cost != -1, "Missing required column 'output'");
+	// in a BFS the cost of a path is its number of hops
+	CHECK(max_hops == -1 || pos_in_weights == -1, "The attribute 'max_hops' is only supported for unweighted shortest paths");
+	lng bound = (max_hops != -1 && (max_cost == -1 || max_hops < max_cost)) ? max_hops : max_cost;
 
-	BatHandle weights;
-	if(pos_in_weights != -1){
-		weights = get_arg(pos_in_weights);
-	}
-
-	query.request_shortest_path(move(weights), pos_out_cost, pos_out_path);
+	return RequestPlan::ShortestPathPlan{ pos_in_weights, pos_out_cost, pos_out_path, bound };
 }
 
-
-void parse_request(Query& query, MalStkPtr stackPtr, InstrPtr instrPtr) {
-	const char* request = *((const char**) getArgReference(stackPtr, instrPtr, instrPtr->retc));
-	auto get_arg = [stackPtr, instrPtr](int index) {
-		CHECK(index >= 0 && index < instrPtr->argc, "Invalid argument position: " << index);
-//		bat* bb = (bat*) getArgReference(stackPtr, instrPtr, index);
-//		cout << "[get_arg] index: " << index << ", value: " << ((bb == nullptr) ? -2 : *bb) << endl;
-		return (bat*) getArgReference(stackPtr, instrPtr, index);
-	};
-
-	{ // print to stdout the request ?
-		char* env_debug = getenv("GRAPH_DUMP_PARSER");
-		if(env_debug != nullptr && (strcmp(env_debug, "1") == 0 || strcmp(env_debug, "true") == 0)){
-			cout << request << endl;;
-		}
-	}
-
-	// default attributes
-	GraphDescriptorType graph_type = e_graph_columns;
+static shared_ptr<const RequestPlan> compile_request(const char* request){
+	shared_ptr<RequestPlan> plan { new RequestPlan() };
 
 	// parse the request
 	XMLDocument xml_document(true, Whitespace::COLLAPSE_WHITESPACE);
@@ -173,9 +194,9 @@ void parse_request(Query& query, MalStkPtr stackPtr, InstrPtr instrPtr) {
 		if(tag == "operation"){
 			string operation = e->GetText();
 			if(operation == "join"){
-				query.operation = op_join;
+				plan->operation = op_join;
 			} else if (operation == "filter") {
-				query.operation = op_filter;
+				plan->operation = op_filter;
 			} else {
 				ERROR("Invalid operation: " << operation);
 			}
@@ -187,11 +208,12 @@ void parse_request(Query& query, MalStkPtr stackPtr, InstrPtr instrPtr) {
 			ParseExpectedColumn columns[] = { {"candidates_left"} , {"candidates_right", /*required=*/false}, {"src"}, {"dst"}, {nullptr} };
 			parse_columns(e, columns);
 
-			query.candidates_left = get_arg(columns[cl].pos);
+			plan->has_input = true;
+			plan->pos_candidates_left = columns[cl].pos;
 			if(columns[cr].set)
-				query.candidates_right = get_arg(columns[cr].pos);
-			query.query_src = get_arg(columns[src].pos);
-			query.query_dst = get_arg(columns[dst].pos);
+				plan->pos_candidates_right = columns[cr].pos;
+			plan->pos_src = columns[src].pos;
+			plan->pos_dst = columns[dst].pos;
 		}
 
 		// graph
@@ -199,39 +221,42 @@ void parse_request(Query& query, MalStkPtr stackPtr, InstrPtr instrPtr) {
 			// parse the attributes
 
 			// graph type
-//			auto attr_graph_type = e->FindAttribute("type");
-//			if(attr_graph_type){
-//				string graph_type_str = attr_graph_type->Value();
-//				if(graph_type == "columns"){
-//					graph_type = e_graph_columns;
-//				} else if (graph_type == "compact") {
-//					graph_type = e_graph_compact;
-//				}
-//			}
+			GraphDescriptorType graph_type = e_graph_columns;
+			const char* attr_graph_type = e->Attribute("type");
+			if(attr_graph_type){
+				string graph_type_str = attr_graph_type;
+				if(graph_type_str == "columns"){
+					graph_type = e_graph_columns;
+				} else if (graph_type_str == "compact") {
+					graph_type = e_graph_compact;
+				} else {
+					ERROR("Invalid graph type: " << graph_type_str);
+				}
+			}
 
 			// parse the children
-			// e_graph_columns
+			plan->has_graph = true;
+			plan->graph_type = graph_type;
 			switch(graph_type){
 			case e_graph_columns: {
-				enum { i_src = 0, i_dst };
-				ParseExpectedColumn columns[] = { {"src"} , {"dst"}, {nullptr} };
+				enum { i_src = 0, i_dst, i_mask };
+				ParseExpectedColumn columns[] = { {"src"} , {"dst"}, {"mask", /*required=*/false}, {nullptr} };
 				parse_columns(e, columns);
 
-				BatHandle edges_src{get_arg(columns[i_src].pos)};
-				BatHandle edges_dst{get_arg(columns[i_dst].pos)};
-				query.graph.reset( new GraphDescriptorColumns(move(edges_src), move(edges_dst)) );
+				plan->pos_graph_src = columns[i_src].pos;
+				plan->pos_graph_dst = columns[i_dst].pos;
+				if(columns[i_mask].set)
+					plan->pos_graph_mask = columns[i_mask].pos;
 			} break;
 			case e_graph_compact: {
 				enum { i_src = 0, i_dst, i_perm, i_count };
 				ParseExpectedColumn columns[] = { {"src"} , {"dst"}, {"id"}, {"count"}, {nullptr} };
 				parse_columns(e, columns);
 
-				BatHandle edges_src{get_arg(columns[i_src].pos)};
-				BatHandle edges_dst{get_arg(columns[i_dst].pos)};
-				BatHandle edges_id{get_arg(columns[i_perm].pos)};
-				lng* count = (lng*) getArgReference(stackPtr, instrPtr, columns[i_count].pos);
-				CHECK(count != nullptr, "Argument 'count' is null");
-				query.graph.reset( new GraphDescriptorCompact{move(edges_src), move(edges_dst), move(edges_id), (size_t) *count});
+				plan->pos_graph_src = columns[i_src].pos;
+				plan->pos_graph_dst = columns[i_dst].pos;
+				plan->pos_graph_id = columns[i_perm].pos;
+				plan->pos_graph_count = columns[i_count].pos;
 			} break;
 			default:
 				ERROR("Invalid graph type: " << graph_type);
@@ -246,7 +271,7 @@ void parse_request(Query& query, MalStkPtr stackPtr, InstrPtr instrPtr) {
 			do {
 				XMLElement* e = base_node->ToElement();
 				if(!e) continue;
-				parse_shortest_path(query, stackPtr, instrPtr, e);
+				plan->shortest_paths.push_back(parse_shortest_path(e));
 			} while ( (base_node = base_node->NextSibling()) != nullptr );
 		}
 
@@ -256,14 +281,136 @@ void parse_request(Query& query, MalStkPtr stackPtr, InstrPtr instrPtr) {
 			ParseExpectedColumn columns[] = { {"candidates_left"} , {"candidates_right", false}, {nullptr} };
 			parse_columns(e, columns);
 
-			query.set_pos_output_left(columns[i_left].pos);
-			query.set_pos_output_right(columns[i_right].pos);
+			plan->has_output = true;
+			plan->pos_output_left = columns[i_left].pos;
+			plan->pos_output_right = columns[i_right].pos;
 		}
 
 		else {
 			ERROR("Invalid element: " << tag);
 		}
 	} while ( (base_node = base_node->NextSibling()) != nullptr );
+
+	return plan;
+}
+
+// Retrieve the compiled form of the request, parsing it only the first time it is seen. The least recently used
+// plans are evicted first
+static shared_ptr<const RequestPlan> get_plan(const char* request){
+	using list_t = list<pair<string, shared_ptr<const RequestPlan>>>;
+	static mutex cache_mutex;
+	static list_t entries; // the most recently used first
+	static unordered_map<string, list_t::iterator> index;
+
+	string key { request };
+	{
+		lock_guard<mutex> lock(cache_mutex);
+		auto it = index.find(key);
+		if(it != index.end()){
+			entries.splice(entries.begin(), entries, it->second);
+			return it->second->second;
+		}
+	}
+
+	shared_ptr<const RequestPlan> plan = compile_request(request); // outside the critical section
+	{
+		lock_guard<mutex> lock(cache_mutex);
+		auto it = index.find(key);
+		if(it != index.end()){ // compiled in the meanwhile by another thread
+			entries.splice(entries.begin(), entries, it->second);
+			return it->second->second;
+		}
+		entries.emplace_front(key, plan);
+		index.emplace(move(key), entries.begin());
+		while(entries.size() > PLAN_CACHE_SIZE){
+			index.erase(entries.back().first);
+			entries.pop_back();
+		}
+	}
+
+	return plan;
+}
+
+void parse_request(Query& query, MalStkPtr stackPtr, InstrPtr instrPtr) {
+	const char* request = *((const char**) getArgReference(stackPtr, instrPtr, instrPtr->retc));
+	auto get_arg = [stackPtr, instrPtr](int index) {
+		CHECK(index >= 0 && index < instrPtr->argc, "Invalid argument position: " << index);
+//		bat* bb = (bat*) getArgReference(stackPtr, instrPtr, index);
+//		cout << "[get_arg] index: " << index << ", value: " << ((bb == nullptr) ? -2 : *bb) << endl;
+		return (bat*) getArgReference(stackPtr, instrPtr, index);
+	};
+
+	// print to stdout the request ?
+	if(configuration().dump_parser()){
+		cout << request << endl;
+	}
+
+	shared_ptr<const RequestPlan> plan = get_plan(request);
+
+	// operation kind
+	if(plan->operation != op_invalid){
+		query.operation = plan->operation;
+	}
+
+	// input columns
+	if(plan->has_input){
+		query.candidates_left = get_arg(plan->pos_candidates_left);
+		if(plan->pos_candidates_right != -1)
+			query.candidates_right = get_arg(plan->pos_candidates_right);
+		query.query_src = get_arg(plan->pos_src);
+		query.query_dst = get_arg(plan->pos_dst);
+	}
+
+	// graph
+	if(plan->has_graph){
+		switch(plan->graph_type){
+		case e_graph_columns: {
+			BatHandle edges_src{get_arg(plan->pos_graph_src)};
+			BatHandle edges_dst{get_arg(plan->pos_graph_dst)};
+			BatHandle edges_mask;
+			if(plan->pos_graph_mask != -1){
+				edges_mask = get_arg(plan->pos_graph_mask);
+				int mask_type = edges_mask.get()->ttype;
+				CHECK(mask_type == TYPE_void || mask_type == TYPE_oid || mask_type == TYPE_bit, "Invalid type for the column <graph>/mask: " << mask_type);
+				CHECK(mask_type != TYPE_bit || edges_mask.size() == edges_src.size(), "The column <graph>/mask has " << edges_mask.size() << " values, expected one for each edge: " << edges_src.size());
+			}
+			query.graph.reset( new GraphDescriptorColumns(move(edges_src), move(edges_dst), move(edges_mask)) );
+		} break;
+		case e_graph_compact: {
+			BatHandle edges_src{get_arg(plan->pos_graph_src)};
+			BatHandle edges_dst{get_arg(plan->pos_graph_dst)};
+			BatHandle edges_id{get_arg(plan->pos_graph_id)};
+			lng* count = (lng*) getArgReference(stackPtr, instrPtr, plan->pos_graph_count);
+			CHECK(count != nullptr, "Argument 'count' is null");
+			CHECK(*count >= 0 && edges_src.size() == (size_t) *count, "The column <graph>/src has " << edges_src.size() << " offsets, expected one for each vertex: " << *count);
+			CHECK(edges_dst.size() == edges_id.size(), "The columns <graph>/dst and <graph>/id have a different size: " << edges_dst.size() << " != " << edges_id.size());
+			CHECK(*count == 0 || edges_src.last<oid>() == edges_dst.size(), "The offsets in <graph>/src do not match the number of edges: " << edges_dst.size());
+			query.graph.reset( new GraphDescriptorCompact{move(edges_src), move(edges_dst), move(edges_id), (size_t) *count});
+		} break;
+		default:
+			ERROR("Invalid graph type: " << plan->graph_type);
+		}
+	}
+
+	// shortest paths
+	for(const auto& sp : plan->shortest_paths){
+		BatHandle weights;
+		if(sp.pos_weights != -1){
+			weights = get_arg(sp.pos_weights);
+			if(plan->has_graph && plan->graph_type == e_graph_compact){ // permuted by graph.make, one value for each edge
+				const std::size_t num_edges = static_cast<GraphDescriptorCompact*>(query.graph.get())->edge_dst.size();
+				CHECK(weights.size() == num_edges, "The column <shortest_path>/in_weights has " << weights.size() << " values, expected one for each edge: " << num_edges);
+			}
+		}
+
+		query.request_shortest_path(move(weights), sp.pos_cost, sp.pos_path, sp.bound);
+	}
+
+	// output
+	if(plan->has_output){
+		query.set_pos_output_left(plan->pos_output_left);
+		query.set_pos_output_right(plan->pos_output_right);
+	}
 }
 
 } /*namespace gr8*/
@@ -8,9 +8,18 @@
 #include "prepare.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <bitset>
 #include <cassert>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
 
+#include "configuration.hpp"
 #include "debug.h"
+#include "graph_index.hpp"
 
 namespace gr8 {
 
@@ -24,7 +33,11 @@ void reorder_computations(Query& q){
 	auto ordering_cost = [](const ShortestPath& sp){
 		size_t cost = 0;
 
-		// BFS should come first
+		// Bounded searches first, the pairs are joined by the first shortest path and
+		// those beyond the bound are not connected
+		if(!sp.bounded()){ cost += 1000; }
+
+		// BFS should come next
 		if(!sp.bfs()){ cost += 100; }
 
 		// Path computation second
@@ -92,12 +105,290 @@ str ALGprojection(bat *result, const bat *lid, const bat *rid);
 str GRAPHprefixsum(bat* id_output, const bat* id_input, const lng* ptr_domain_cardinality);
 } // extern "C"
 
-// side effect: we need to reorder also the weights in q.shortest_paths
-static GraphDescriptorCompact* to_compact_sequential(Query& q, GraphDescriptorColumns* graph){
-	if(graph->edge_src.empty()){ // edge case
-		return new GraphDescriptorCompact(BatHandle{}, BatHandle{}, BatHandle{}, 0);
+// Remap the vertex ids when the domain [0, max_value] is at least this many times the number of actual vertices
+static constexpr std::size_t VERTEX_DOMAIN_MIN_SPARSITY = 2; // arbitrary value
+
+// Do not bother to compact domains smaller than this size
+static constexpr std::size_t VERTEX_DOMAIN_MIN_SIZE = 1024; // arbitrary value
+
+// Rebuild the compact edges of a cached graph once the edges in its delta exceed this percentage of its base
+static constexpr std::size_t DELTA_MAX_EDGES_PCT = 10; // arbitrary value
+
+// Number of edges hashed together to detect the changes of the edge columns
+static constexpr std::size_t EDGE_CHUNK_SIZE = 1024; // arbitrary value
+
+// Number of positions of the edge columns sampled by the quick check of their content
+static constexpr std::size_t EDGE_SAMPLE_SIZE = 256; // arbitrary value
+
+namespace {
+
+// Set of the vertex ids occurring in the graph and in the query, with the rank of each id to remap a sparse
+// domain [0, max_value] into the dense domain [0, size())
+class VertexDomain {
+	std::vector<uint64_t> bitmap;
+	std::vector<std::size_t> ranks; // number of vertices before each word of the bitmap
+
+public:
+	VertexDomain(oid max_value) : bitmap(max_value / 64 +1, 0) { }
+
+	void add(const oid* values, std::size_t count){
+		uint64_t* __restrict B = bitmap.data();
+		for(std::size_t i = 0; i < count; i++){
+			B[values[i] / 64] |= ((uint64_t) 1) << (values[i] % 64);
+		}
+	}
+
+	void add(const BatHandle& column){
+		const OidColumn values = column.oids();
+		if(!values.dense()){
+			add(values.data(), column.size());
+		} else {
+			for(std::size_t i = 0, count = column.size(); i < count; i++){
+				bitmap[values[i] / 64] |= ((uint64_t) 1) << (values[i] % 64);
+			}
+		}
+	}
+
+	// compute the ranks, to be invoked once all vertices have been added
+	std::size_t finalise(){
+		ranks.resize(bitmap.size());
+		std::size_t sum = 0;
+		for(std::size_t i = 0; i < bitmap.size(); i++){
+			ranks[i] = sum;
+			sum += std::bitset<64>(bitmap[i]).count();
+		}
+		return sum;
+	}
+
+	// is the value in the domain?
+	bool contains(oid value) const {
+		return value / 64 < bitmap.size() && ((bitmap[value / 64] >> (value % 64)) & 1);
+	}
+
+	oid rank(oid value) const {
+		uint64_t mask = (((uint64_t) 1) << (value % 64)) -1;
+		return ranks[value / 64] + std::bitset<64>(bitmap[value / 64] & mask).count();
+	}
+
+	// create a new column with the ranks of the given column
+	BatHandle remap(const BatHandle& input) const {
+		const std::size_t count = input.size();
+		BatHandle output { COLnew(0, TYPE_oid, count, TRANSIENT) };
+		MAL_ASSERT(output.initialised(), MAL_MALLOC_FAIL);
+		const OidColumn in = input.oids();
+		oid* __restrict out = output.array<oid>();
+		for(std::size_t i = 0; i < count; i++){
+			out[i] = rank(in[i]);
+		}
+		BAT* b = output.get();
+		BATsetcount(b, count);
+		b->tsorted = input.get()->tsorted; // the ranks preserve the order
+		b->trevsorted = input.get()->trevsorted;
+		b->tkey = input.get()->tkey;
+		b->tnonil = 1; b->tnil = 0;
+		return output;
+	}
+
+	// create the reverse mapping, from the dense domain to the original vertex ids
+	BatHandle vertex_ids(std::size_t count) const {
+		BatHandle output { COLnew(0, TYPE_oid, count, TRANSIENT) };
+		MAL_ASSERT(output.initialised(), MAL_MALLOC_FAIL);
+		oid* __restrict out = output.array<oid>();
+		std::size_t pos = 0;
+		for(std::size_t i = 0; i < bitmap.size(); i++){
+			for(uint64_t word = bitmap[i]; word != 0; word &= word -1){
+				std::size_t bit = 0;
+				while(((word >> bit) & 1) == 0) bit++;
+				out[pos++] = i * 64 + bit;
+			}
+		}
+		assert(pos == count);
+		BAT* b = output.get();
+		BATsetcount(b, count);
+		b->tsorted = 1; b->trevsorted = count <= 1; b->tkey = 1;
+		b->tnonil = 1; b->tnil = 0;
+		return output;
+	}
+};
+
+// Quick summary of the edge columns: their size, the edges at EDGE_SAMPLE_SIZE positions spread over the columns
+// and the hash of their last chunk, where the appends land. It misses most updates in place.
+struct EdgeSample {
+	std::size_t size = 0;
+	std::vector<oid> values; // src and dst of the sampled edges
+	uint64_t tail_src = 0;
+	uint64_t tail_dst = 0;
+
+	EdgeSample(const GraphDescriptorColumns* graph) : size(graph->edge_src.size()) {
+		const OidColumn src = graph->edge_src.oids();
+		const OidColumn dst = graph->edge_dst.oids();
+		const std::size_t step = std::max<std::size_t>(1, size / EDGE_SAMPLE_SIZE);
+		for(std::size_t i = 0; i < size; i += step){
+			values.push_back(src[i]);
+			values.push_back(dst[i]);
+		}
+		const std::size_t begin = size - std::min(size, EDGE_CHUNK_SIZE);
+		tail_src = content_hash(graph->edge_src, begin, size);
+		tail_dst = content_hash(graph->edge_dst, begin, size);
+	}
+
+	bool operator==(const EdgeSample& other) const {
+		return size == other.size && tail_src == other.tail_src && tail_dst == other.tail_dst && values == other.values;
+	}
+};
+
+// Content of the edge columns, as the hashes of their chunks of EDGE_CHUNK_SIZE edges. The last chunk may be partial.
+class EdgeFingerprint {
+	std::size_t _size = 0; // number of edges covered
+	std::vector<uint64_t> src;
+	std::vector<uint64_t> dst;
+	EdgeSample _sample;
+
+public:
+	// Hash all edges of the columns
+	EdgeFingerprint(const GraphDescriptorColumns* graph, EdgeSample sample) : _size(graph->edge_src.size()), _sample(std::move(sample)) {
+		for(std::size_t begin = 0; begin < _size; begin += EDGE_CHUNK_SIZE){
+			std::size_t end = std::min(_size, begin + EDGE_CHUNK_SIZE);
+			src.push_back(content_hash(graph->edge_src, begin, end));
+			dst.push_back(content_hash(graph->edge_dst, begin, end));
+		}
 	}
 
+	std::size_t size() const { return _size; }
+	const EdgeSample& sample() const { return _sample; }
+
+	bool operator==(const EdgeFingerprint& other) const {
+		return _size == other._size && src == other.src && dst == other.dst;
+	}
+
+	// Chunks of `previous' whose edges have been updated in place or removed since, in the current columns
+	std::vector<bool> changed_chunks(const EdgeFingerprint& previous, const GraphDescriptorColumns* graph) const {
+		std::vector<bool> result(previous.src.size(), false);
+		for(std::size_t i = 0; i < result.size(); i++){
+			const std::size_t begin = i * EDGE_CHUNK_SIZE;
+			const std::size_t end = std::min(previous._size, begin + EDGE_CHUNK_SIZE);
+			if(end > _size){ // truncated
+				result[i] = true;
+			} else if(end - begin == EDGE_CHUNK_SIZE){ // same boundaries
+				result[i] = src[i] != previous.src[i] || dst[i] != previous.dst[i];
+			} else { // the last chunk of `previous' is partial, hash the same range
+				result[i] = content_hash(graph->edge_src, begin, end) != previous.src[i] ||
+						content_hash(graph->edge_dst, begin, end) != previous.dst[i];
+			}
+		}
+		return result;
+	}
+};
+
+// Edges sorted by source in the compact form, before the weights and the mask of a query are applied. The changes
+// of the columns afterwards are kept aside in a delta, until it becomes large enough to rebuild the base: the edges
+// appended or updated in place are added to the delta, while the edges of the base removed or updated are disabled.
+struct CompactEdges {
+	BatHandle vertices; // prefix sum of the out-degrees
+	BatHandle edges; // destination of each edge in the base
+	BatHandle edge_ids; // original position of each edge, in the base and then in the delta
+	std::size_t vertex_count = 0;
+	BatHandle vertex_ids; // original id of each vertex when the domain has been compacted, empty otherwise
+	std::shared_ptr<const VertexDomain> domain; // idem, to remap the query vertices
+	BatHandle delta_src; // edges in the delta, sorted by source, empty if none
+	BatHandle delta_dst;
+	std::vector<uint64_t> deleted; // bitmap over the positions of the edges no longer in the columns, empty if none
+	BatHandle base_ids; // original position of each edge in the base, edge_ids may differ for the removed edges
+	std::shared_ptr<const EdgeFingerprint> base_content; // content of the columns when the base was built, if cached
+	std::shared_ptr<const EdgeFingerprint> content; // content of the columns covered by the base and the delta, idem
+	uint64_t version = 0; // unique for each instance
+
+	bool remapped() const { return domain != nullptr; }
+	std::size_t num_edges() const { return edge_ids.size(); }
+};
+
+// Source of the versions of the compact edges
+static std::atomic<uint64_t> next_version { 1 };
+
+// Compact edges built from persistent columns, retained across the queries with a LRU policy. The entries keep a
+// reference to the edge columns, so that their ids cannot be recycled. The caller validates an entry against the
+// current content of the columns: in full while the columns have changes not yet committed, otherwise only against
+// an EdgeSample. An update in place committed between two queries goes unnoticed unless it alters the sample.
+class CompactGraphCache {
+	struct Entry {
+		BatHandle edge_src;
+		BatHandle edge_dst;
+		std::shared_ptr<const CompactEdges> graph;
+	};
+
+	std::mutex mutex;
+	std::list<Entry> entries; // the most recently used first
+
+	static bool same_columns(const Entry& entry, const GraphDescriptorColumns* graph){
+		return entry.edge_src.id() == graph->edge_src.id() && entry.edge_dst.id() == graph->edge_dst.id();
+	}
+
+public:
+	static bool cacheable(const GraphDescriptorColumns* graph){
+		return configuration().graph_cache_size() > 0 &&
+				graph->edge_src.get()->batPersistence == PERSISTENT &&
+				graph->edge_dst.get()->batPersistence == PERSISTENT;
+	}
+
+	// Retrieve the compact edges of the given columns, possibly built from a previous content of the columns
+	std::shared_ptr<const CompactEdges> get(const GraphDescriptorColumns* graph){
+		std::lock_guard<std::mutex> lock(mutex);
+		for(auto it = entries.begin(); it != entries.end(); ++it){
+			if(same_columns(*it, graph)){
+				entries.splice(entries.begin(), entries, it);
+				return it->graph;
+			}
+		}
+		return nullptr;
+	}
+
+	void put(const GraphDescriptorColumns* graph, std::shared_ptr<const CompactEdges> compact){
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.remove_if([graph](const Entry& entry){ return same_columns(entry, graph); }); // concurrent builds
+		entries.push_front(Entry{graph->edge_src, graph->edge_dst, std::move(compact)});
+		while(entries.size() > (std::size_t) configuration().graph_cache_size()){
+			entries.pop_back();
+		}
+	}
+};
+
+// Never destroyed, the BATs cannot be released once the GDK has been shut down
+CompactGraphCache& graph_cache(){
+	static CompactGraphCache* instance = new CompactGraphCache();
+	return *instance;
+}
+
+} // anonymous namespace
+
+// Max value in a non empty column of oids
+static oid max_oid(const BatHandle& column){
+	const OidColumn values = column.oids();
+	const std::size_t size = column.size();
+	if(values.dense()) return values[size -1];
+	return *(std::max_element(values.data(), values.data() + size));
+}
+
+// Copy a dense column into a column of oids, for the arrays of the compact graph that are accessed at random
+static BatHandle materialise(const BatHandle& column){
+	const std::size_t count = column.size();
+	BatHandle output { COLnew(0, TYPE_oid, count, TRANSIENT) };
+	MAL_ASSERT(output.initialised(), MAL_MALLOC_FAIL);
+	const OidColumn in = column.oids();
+	oid* __restrict out = output.array<oid>();
+	for(std::size_t i = 0; i < count; i++){
+		out[i] = in[i];
+	}
+	BAT* b = output.get();
+	BATsetcount(b, count);
+	b->tsorted = 1; b->trevsorted = count <= 1; b->tkey = 1;
+	b->tnonil = 1; b->tnil = 0;
+	return output;
+}
+
+// Sort the edges by source and compute their prefix sum. When `q' is given, its vertices are also added to the
+// domain of a compacted graph, otherwise remap_query may fail on them. With `compact_domain' unset, the vertex ids
+// are always retained.
+static std::shared_ptr<CompactEdges> make_compact_edges(const GraphDescriptorColumns* graph, const Query* q, bool compact_domain = true){
 	str rc = MAL_SUCCEED;
 	bat	input = -1;
 	bat output = -1;
@@ -105,6 +396,7 @@ static GraphDescriptorCompact* to_compact_sequential(Query& q, GraphDescriptorCo
 	bit reverse = false;
 	bit stable = false;
 
+	std::shared_ptr<CompactEdges> result { new CompactEdges() };
 	BatHandle edge_src, edge_dst;
 
 	// sort the inputs
@@ -112,26 +404,307 @@ static GraphDescriptorCompact* to_compact_sequential(Query& q, GraphDescriptorCo
 	rc = ALGsort12(&output, &perm, &input, &reverse, &stable);
 	MAL_ASSERT_RC();
 	edge_src = BatHandle(&output);
+	result->edge_ids = BatHandle(perm);
 
 	input = graph->edge_dst.id();
 	rc = ALGprojection(&output, &perm, &input);
 	MAL_ASSERT_RC();
 	edge_dst = BatHandle(&output);
 
-	// find the max value
-	oid* dst = edge_dst.array<oid>();
-	auto max_value = *(std::max_element(dst, dst + edge_dst.size()));
-	max_value = std::max(max_value, edge_src.last<oid>());
+	// find the max value, also among the query vertices as they index the arrays of the search
+	auto max_value = std::max(max_oid(edge_dst), edge_src.last<oid>());
+	if(q != nullptr && !q->query_src.empty()){
+		max_value = std::max(max_value, std::max(max_oid(q->query_src), max_oid(q->query_dst)));
+	}
+	lng count = (lng) max_value +1;
+
+	// compact a sparse domain of vertex ids
+	if(compact_domain && max_value +1 >= VERTEX_DOMAIN_MIN_SIZE){
+		std::shared_ptr<VertexDomain> domain { new VertexDomain(max_value) };
+		domain->add(edge_src);
+		domain->add(edge_dst);
+		if(q != nullptr){
+			domain->add(q->query_src);
+			domain->add(q->query_dst);
+		}
+		std::size_t num_vertices = domain->finalise();
+
+		if(num_vertices * VERTEX_DOMAIN_MIN_SPARSITY <= max_value +1){
+			BatHandle sorted_src = std::move(edge_src);
+			edge_src = domain->remap(sorted_src);
+			BBPrelease(sorted_src.id()); // release the logical reference to the sorted edges
+			BatHandle projected_dst = std::move(edge_dst);
+			edge_dst = domain->remap(projected_dst);
+			BBPrelease(projected_dst.id());
+			result->vertex_ids = domain->vertex_ids(num_vertices);
+			result->domain = std::move(domain);
+			count = (lng) num_vertices;
+		}
+	}
 
 	// prefix sum on the src
-	lng count = (lng) max_value +1;
 	input = edge_src.id();
 	rc = GRAPHprefixsum(&output, &input, &count);
-	BBPrelease(input); input = -1; // release the logical reference to the sorted edges
+	if(!result->remapped()) { BBPrelease(input); } input = -1; // release the logical reference to the sorted edges
 	MAL_ASSERT_RC();
 	edge_src = BatHandle(&output);
 
+	// release the logical references
+	BBPrelease(edge_src.id());
+	if(!result->remapped()) { BBPrelease(edge_dst.id()); }
+	BBPrelease(result->edge_ids.id());
+
+	result->vertices = std::move(edge_src);
+	result->edges = edge_dst.dense() ? materialise(edge_dst) : std::move(edge_dst); // scanned by the searches
+	result->vertex_count = (std::size_t) count;
+	result->version = next_version++;
+	return result;
+}
+
+// Retrieve the compact edges stored in the farm, nullptr if absent or stale
+static std::shared_ptr<CompactEdges> load_compact_edges(const GraphDescriptorColumns* graph){
+	GraphIndex index;
+	if(!load_graph_index(graph, index)) return nullptr;
+
+	std::shared_ptr<CompactEdges> result { new CompactEdges() };
+	result->vertices = std::move(index.vertices);
+	result->edges = std::move(index.edges);
+	result->edge_ids = std::move(index.edge_ids);
+	result->vertex_count = index.vertex_count;
+	if(index.vertex_ids.initialised()){ // rebuild the domain to remap the query vertices
+		std::shared_ptr<VertexDomain> domain { new VertexDomain(index.vertex_ids.last<oid>()) };
+		domain->add(index.vertex_ids);
+		domain->finalise();
+		result->vertex_ids = std::move(index.vertex_ids);
+		result->domain = std::move(domain);
+	}
+	result->version = next_version++;
+	return result;
+}
+
+// Store the compact edges in the farm, to be reloaded after a restart
+static void save_compact_edges(const GraphDescriptorColumns* graph, const CompactEdges& compact){
+	GraphIndex index;
+	index.vertices = compact.vertices;
+	index.edges = compact.edges;
+	index.edge_ids = compact.edge_ids;
+	index.vertex_ids = compact.vertex_ids;
+	index.vertex_count = compact.vertex_count;
+	save_graph_index(graph, index); // best effort, otherwise the graph is built again after a restart
+}
+
+// Create a transient column of `count' oids, to be filled by the caller
+static BatHandle make_oid_column(std::size_t count){
+	BatHandle output { COLnew(0, TYPE_oid, count, TRANSIENT) };
+	MAL_ASSERT(output.initialised(), MAL_MALLOC_FAIL);
+	BAT* b = output.get();
+	BATsetcount(b, count);
+	b->tsorted = b->trevsorted = b->tkey = count <= 1;
+	b->tnonil = 1; b->tnil = 0;
+	return output;
+}
+
+// Apply to the compact edges the changes of the columns since its base was built, without sorting the base again.
+// The edges of the base in the chunks that changed are disabled, while the current edges of those chunks and the
+// appended edges are added to the delta. Return nullptr if the base needs to be rebuilt: the delta would be too
+// large or its edges refer to vertices outside the domain of the base.
+static std::shared_ptr<CompactEdges> update_compact_edges(const CompactEdges& compact, const GraphDescriptorColumns* graph, std::shared_ptr<const EdgeFingerprint> content){
+	const std::size_t num_base_edges = compact.edges.size();
+	const std::size_t num_edges = graph->edge_src.size();
+	assert(compact.base_content != nullptr && compact.base_content->size() == num_base_edges && compact.base_ids.size() == num_base_edges);
+	const std::vector<bool> changed = content->changed_chunks(*compact.base_content, graph);
+
+	// positions of the edges in the delta, the current edges of the chunks changed and then the appended edges
+	std::vector<std::size_t> positions;
+	for(std::size_t c = 0; c < changed.size(); c++){
+		if(!changed[c]) continue;
+		const std::size_t end = std::min(std::min(num_edges, num_base_edges), (c +1) * EDGE_CHUNK_SIZE);
+		for(std::size_t i = c * EDGE_CHUNK_SIZE; i < end; i++){ positions.push_back(i); }
+	}
+	for(std::size_t i = num_base_edges; i < num_edges; i++){ positions.push_back(i); }
+	const std::size_t num_delta_edges = positions.size();
+	if(num_delta_edges * 100 > num_base_edges * DELTA_MAX_EDGES_PCT) return nullptr;
+
+	// translate the vertices of the edges in the delta and sort them by source
+	const OidColumn src = graph->edge_src.oids();
+	const OidColumn dst = graph->edge_dst.oids();
+	auto translate = [&compact](oid vertex, oid& out){
+		if(compact.remapped()){
+			if(!compact.domain->contains(vertex)) return false;
+			out = compact.domain->rank(vertex);
+		} else {
+			if(vertex >= compact.vertex_count) return false;
+			out = vertex;
+		}
+		return true;
+	};
+	std::vector<std::pair<oid, std::size_t>> order; // <source, position>
+	order.reserve(num_delta_edges);
+	for(std::size_t pos : positions){
+		oid vertex;
+		if(!translate(src[pos], vertex)) return nullptr;
+		order.emplace_back(vertex, pos);
+	}
+	std::sort(begin(order), end(order));
+
+	std::shared_ptr<CompactEdges> result { new CompactEdges() };
+	result->vertices = compact.vertices;
+	result->edges = compact.edges;
+	result->vertex_count = compact.vertex_count;
+	result->vertex_ids = compact.vertex_ids;
+	result->domain = compact.domain;
+	result->delta_src = make_oid_column(num_delta_edges);
+	result->delta_dst = make_oid_column(num_delta_edges);
+	result->edge_ids = make_oid_column(num_base_edges + num_delta_edges);
+
+	oid* __restrict delta_src = result->delta_src.array<oid>();
+	oid* __restrict delta_dst = result->delta_dst.array<oid>();
+	oid* __restrict edge_ids = result->edge_ids.array<oid>();
+	const OidColumn base_edge_ids = compact.base_ids.oids();
+	const oid hseqbase = graph->edge_src.get()->hseqbase;
+	bool any_deleted = false;
+	std::vector<uint64_t> deleted((num_base_edges + num_delta_edges) / 64 +1, 0);
+	for(std::size_t i = 0; i < num_base_edges; i++){
+		const std::size_t pos = base_edge_ids[i] - hseqbase;
+		edge_ids[i] = base_edge_ids[i];
+		if(changed[pos / EDGE_CHUNK_SIZE]){
+			deleted[i / 64] |= ((uint64_t) 1) << (i % 64);
+			any_deleted = true;
+			if(pos >= num_edges) edge_ids[i] = hseqbase; // any valid position, to permute the weights
+		}
+	}
+	for(std::size_t i = 0; i < num_delta_edges; i++){
+		delta_src[i] = order[i].first;
+		if(!translate(dst[order[i].second], delta_dst[i])) return nullptr;
+		edge_ids[num_base_edges + i] = hseqbase + order[i].second;
+	}
+	result->delta_src.get()->tsorted = 1;
+	if(any_deleted) result->deleted = std::move(deleted);
+
+	result->base_ids = compact.base_ids;
+	result->base_content = compact.base_content;
+	result->content = std::move(content);
+	result->version = next_version++;
+	return result;
+}
+
+// Translate the query vertices into the domain of the compact edges. Return false if some of them do not occur in
+// the domain, without altering the query.
+static bool remap_query(Query& q, const CompactEdges& graph){
+	const std::size_t qsize = q.query_src.size();
+	const OidColumn qsrc = q.query_src.oids();
+	const OidColumn qdst = q.query_dst.oids();
+
+	if(graph.remapped()){
+		for(std::size_t i = 0; i < qsize; i++){
+			if(!graph.domain->contains(qsrc[i]) || !graph.domain->contains(qdst[i])) return false;
+		}
+		q.query_src = graph.domain->remap(q.query_src);
+		q.query_dst = graph.domain->remap(q.query_dst);
+	} else {
+		for(std::size_t i = 0; i < qsize; i++){
+			if(qsrc[i] >= graph.vertex_count || qdst[i] >= graph.vertex_count) return false;
+		}
+	}
+
+	return true;
+}
+
+// Bitmap over the positions of the compact edges, of the edges enabled by the mask. The mask is either a candidate
+// list over the edge ids or a bit column with a value for each edge.
+static std::vector<uint64_t> make_edge_mask(const CompactEdges& graph, const BatHandle& mask, oid hseqbase){
+	const std::size_t num_edges = graph.num_edges();
+	auto set = [](std::vector<uint64_t>& bitmap, std::size_t i){ bitmap[i / 64] |= ((uint64_t) 1) << (i % 64); };
+	auto test = [](const std::vector<uint64_t>& bitmap, std::size_t i){ return (bitmap[i / 64] >> (i % 64)) & 1; };
+
+	// enabled edges, by their original position
+	std::vector<uint64_t> enabled(num_edges / 64 +1, 0);
+	BAT* b = mask.get();
+	if(b->ttype == TYPE_bit){
+		const bit* values = mask.array<bit>();
+		for(std::size_t i = 0, sz = mask.size(); i < sz; i++){ // one value for each position of the columns
+			if(values[i] == 1) set(enabled, i); // nil is disabled
+		}
+	} else if (b->ttype == TYPE_void){ // dense candidate list
+		if(b->tseqbase != oid_nil){
+			for(std::size_t i = 0, sz = mask.size(); i < sz; i++){
+				oid pos = b->tseqbase + i - hseqbase;
+				if(pos < num_edges) set(enabled, pos);
+			}
+		}
+	} else { // candidate list
+		const oid* candidates = mask.array<oid>();
+		for(std::size_t i = 0, sz = mask.size(); i < sz; i++){
+			oid pos = candidates[i] - hseqbase;
+			if(pos < num_edges) set(enabled, pos);
+		}
+	}
+
+	// permute in the order of the compact edges
+	std::vector<uint64_t> result(enabled.size(), 0);
+	const OidColumn edge_ids = graph.edge_ids.oids();
+	for(std::size_t i = 0; i < num_edges; i++){
+		if(test(enabled, edge_ids[i] - hseqbase)) set(result, i);
+	}
+
+	return result;
+}
+
+// side effect: we need to reorder also the weights in q.shortest_paths. When the vertex ids are sparse, both the
+// graph and the query vertices are remapped into a dense domain
+static GraphDescriptorCompact* to_compact_sequential(Query& q, GraphDescriptorColumns* graph){
+	if(graph->edge_src.empty()){ // edge case
+		return new GraphDescriptorCompact(BatHandle{}, BatHandle{}, BatHandle{}, 0);
+	}
+
+	// the compact edges of persistent columns are reused across the queries, and across restarts when stored in the farm
+	const bool cacheable = CompactGraphCache::cacheable(graph);
+	std::shared_ptr<const CompactEdges> compact;
+	std::shared_ptr<const EdgeFingerprint> content;
+	if(cacheable){
+		compact = graph_cache().get(graph);
+		EdgeSample sample { graph };
+		const bool committed = !BATdirty(graph->edge_src.get()) && !BATdirty(graph->edge_dst.get());
+		if(compact && committed && compact->content->sample() == sample){ // skip hashing all edges
+			content = compact->content;
+		} else {
+			content.reset(new EdgeFingerprint(graph, std::move(sample)));
+			if(compact && !(*compact->content == *content)){ // the columns changed since the last query
+				compact = update_compact_edges(*compact, graph, content);
+				if(compact) graph_cache().put(graph, compact);
+			}
+		}
+	}
+	if(!compact){
+		const bool persistent = cacheable && configuration().persistent_index();
+		std::shared_ptr<CompactEdges> edges;
+		if(persistent) edges = load_compact_edges(graph);
+		if(!edges){
+			edges = make_compact_edges(graph, cacheable ? nullptr : &q);
+			if(persistent) save_compact_edges(graph, *edges);
+		}
+		if(cacheable){
+			edges->base_ids = edges->edge_ids;
+			edges->base_content = edges->content = content;
+			graph_cache().put(graph, edges);
+		}
+		compact = std::move(edges);
+	}
+	bool cached = cacheable;
+	bool query_remapped = remap_query(q, *compact);
+	if(!query_remapped){ // the query refers to vertices outside the cached graph, build a new one for this query only
+		compact = make_compact_edges(graph, &q);
+		cached = false;
+		query_remapped = remap_query(q, *compact);
+	}
+	assert(query_remapped && "The domain of the graph should include the query vertices");
+	(void) query_remapped; // unused in release builds
+
 	// finally permute the shortest paths weights
+	str rc = MAL_SUCCEED;
+	bat perm = compact->edge_ids.id();
+	bat input = -1;
+	bat output = -1;
 	for(auto& sp : q.shortest_paths){
 		if(!sp.bfs()) {
 			input = sp.weights.id();
@@ -141,20 +714,74 @@ static GraphDescriptorCompact* to_compact_sequential(Query& q, GraphDescriptorCo
 		}
 	}
 
-	// store the permutation array
-	BatHandle edge_id(perm);
+	std::unique_ptr<GraphDescriptorCompact> result { new GraphDescriptorCompact(BatHandle{compact->vertices},
+			BatHandle{compact->edges}, BatHandle{compact->edge_ids}, compact->vertex_count, BatHandle{compact->vertex_ids}) };
 
-	// release the logical references
-	BBPrelease(edge_src.id());
-	BBPrelease(edge_dst.id());
-	BBPrelease(edge_id.id());
+	result->delta_src = compact->delta_src;
+	result->delta_dst = compact->delta_dst;
+	if(cached){ result->version = compact->version; }
 
-//	DEBUG_DUMP(edge_src);
-//	DEBUG_DUMP(edge_dst);
-//	DEBUG_DUMP(edge_id);
+	// skip the edges excluded by the mask and those removed from the columns, rather than building a new graph
+	if(graph->edge_mask.initialised()){
+		result->edge_mask = make_edge_mask(*compact, graph->edge_mask, graph->edge_src.get()->hseqbase);
+		result->version = 0; // the searches depend on the mask
+	}
+	if(!compact->deleted.empty()){
+		if(result->edge_mask.empty()){ result->edge_mask.assign(compact->deleted.size(), ~((uint64_t) 0)); }
+		for(std::size_t i = 0; i < compact->deleted.size(); i++){
+			result->edge_mask[i] &= ~compact->deleted[i];
+		}
+	}
 
 	// done
-	return new GraphDescriptorCompact(std::move(edge_src), std::move(edge_dst), std::move(edge_id), (size_t) count);
+	return result.release();
+}
+
+// A graph from graph.make only covers the vertices up to the max id among its edges. Extend its offsets to the
+// vertices of the query, with no outgoing edges.
+static void extend_compact_graph(const Query& q, GraphDescriptorCompact* graph){
+	assert(!graph->remapped() && "Expected the original vertex ids");
+	if(q.query_src.empty()) return;
+	oid max_value = std::max(max_oid(q.query_src), max_oid(q.query_dst));
+	if(max_value < graph->vertex_count) return;
+
+	const std::size_t count = max_value +1;
+	const std::size_t vertex_count = graph->vertex_count;
+	BatHandle vertices = make_oid_column(count);
+	oid* __restrict out = vertices.array<oid>();
+	const OidColumn in = graph->edge_src.oids();
+	for(std::size_t i = 0; i < vertex_count; i++){
+		out[i] = in[i];
+	}
+	std::fill(out + vertex_count, out + count, vertex_count > 0 ? in[vertex_count -1] : 0);
+	vertices.get()->tsorted = 1;
+
+	graph->edge_src = std::move(vertices);
+	graph->vertex_count = count;
+}
+
+GraphDescriptorCompact* make_compact_graph(const GraphDescriptorColumns* graph, BatHandle* weights){
+	if(graph->edge_src.empty()){ // edge case
+		return new GraphDescriptorCompact(make_oid_column(0), make_oid_column(0), make_oid_column(0), 0);
+	}
+
+	std::shared_ptr<CompactEdges> compact = make_compact_edges(graph, nullptr, /* compact_domain = */ false);
+	assert(!compact->remapped());
+
+	// permute the weights in the order of the edges
+	if(weights != nullptr && weights->initialised()){
+		str rc = MAL_SUCCEED;
+		bat perm = compact->edge_ids.id();
+		bat input = weights->id();
+		bat output = -1;
+		rc = ALGprojection(&output, &perm, &input);
+		MAL_ASSERT_RC();
+		*weights = BatHandle(&output);
+		BBPrelease(output); // release the logical reference
+	}
+
+	return new GraphDescriptorCompact(std::move(compact->vertices), std::move(compact->edges),
+			std::move(compact->edge_ids), compact->vertex_count);
 }
 
 void prepare_graph(Query& q){
@@ -164,9 +791,14 @@ void prepare_graph(Query& q){
 	case e_graph_columns: {
 		q.graph.reset( to_compact_sequential(q, (GraphDescriptorColumns*) q.graph.get()) );
 	} break;
-	case e_graph_compact:
-		/* nop */
-		break;
+	case e_graph_compact: {
+		GraphDescriptorCompact* graph = (GraphDescriptorCompact*) q.graph.get();
+		if(!graph->empty()){ // the offsets and the destinations are scanned by the searches, the edge ids can stay dense
+			if(graph->edge_src.dense()) graph->edge_src = materialise(graph->edge_src);
+			if(graph->edge_dst.dense()) graph->edge_dst = materialise(graph->edge_dst);
+		}
+		extend_compact_graph(q, graph);
+	} break;
 	default:
 		RAISE_ERROR("Invalid graph type: " << q.graph->get_type());
 	}
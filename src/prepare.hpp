@@ -14,6 +14,10 @@ namespace gr8 {
 
 void prepare_graph(Query& q);
 
+// Build the compact form of the given edges, retaining the original vertex ids, for graph.make. When `weights' is
+// given, it is replaced by its permutation in the order of the compact edges.
+GraphDescriptorCompact* make_compact_graph(const GraphDescriptorColumns* graph, BatHandle* weights);
+
 void reorder_computations(Query& q);
 
 }
@@ -4,16 +4,14 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 
 // MonetDB include files
 #include "mal_exception.h"
 
 #include "debug.h"
 
-// if set, sort the inputs if they are not already sorted. Otherwise assume they are already sorted, i.e. codegen
-// should ensure this property.
-//#define GRAPHinterjoinlist_SORT // set from the Makefile
-
 #if !defined(NDEBUG) /* debug only */
 #define _CHECK_ERRLINE_EXPAND(LINE) #LINE
 #define _CHECK_ERRLINE(LINE) _CHECK_ERRLINE_EXPAND(LINE)
@@ -24,9 +22,9 @@
 #define CHECK( EXPR, ERROR ) if ( !(EXPR) ) \
 	{ rc = createException(MAL, function_name /*__FUNCTION__?*/, _CHECK_ERRMSG( EXPR, ERROR ) ); goto error; }
 
-// Get the value in position p from the bat b of type oid
+// Get the value in position p from the bat b of type oid, or of type void: a dense sequence with no heap
 static oid get(BAT* b, BUN p){
-	return *((oid*)Tloc(b, p));
+	return b->T.type == TYPE_void ? b->T.seq + p : *((oid*)Tloc(b, p));
 }
 
 // MAL interface
@@ -62,8 +60,9 @@ GRAPHprefixsum(bat* id_output, const bat* id_input, const lng* ptr_domain_cardin
 	// initialise the result
 	CHECK(output = COLnew(input->hseqbase /*=0*/, TYPE_oid, cardinality, TRANSIENT), MAL_MALLOC_FAIL);
 
-	if(input->T.type == TYPE_oid){
-		// Standard case, the BAT contains a sorted sequence of OIDs
+	// The BAT contains a sorted sequence of OIDs. It may be dense (TYPE_void) in the extreme case where all
+	// vertices have only one outgoing edge, then get() computes its values.
+	if(BATcount(input) > 0){
 		BUN p = 0; // position in the bat
 		BUN count = BATcount(input);
 		oid base = 0, next = 0, sum = 0;
@@ -81,21 +80,6 @@ GRAPHprefixsum(bat* id_output, const bat* id_input, const lng* ptr_domain_cardin
 
 			base++; // move to the next value
 		} while( p < count );
-
-	} else {
-		// FIXME: this branch should be unreachable now
-		// TYPE_void is an optimisation where the BAT holds a sequence of IDs [seqbase, seqbase+1, ..., seqbase+cnt -1]
-		// This can happen in the extreme case where all vertices have only one outgoing edge. We just materialise the BAT
-		// with the sequence of oids
-		BUN count = BATcount(input);
-		oid value = input->T.seq;
-
-		assert(input->T.type == TYPE_void);
-
-		for(BUN i = 0; i < count; i++){
-			BUNappend(output, &value, FALSE);
-			value++;
-		}
 	}
 
 	// fill the remaining vertices in the domain with no outgoing edges
@@ -167,386 +151,60 @@ error:
 
 
 
-// helper method for GRAPHinterjoinlist
-// initialize the bats for candidates, edge_src and edge_dst and copies the fields
-// that are already equal
-static str /* PRIVATE FUNCTION */
-GRAPHinterjoinlist_init_changes(BAT** out_candidates, BAT** out_edge_src, BAT** out_edge_dst,
-		size_t bat_capacity, size_t end_index,
-		oid* __restrict in_candidates, oid* __restrict in_edge_src, oid* __restrict in_edge_dst
-){
-	const char* function_name = "graph.intersect_join_lists";
-	str rc = MAL_SUCCEED;
-	BAT* candidates = *out_candidates = COLnew(0, TYPE_oid, bat_capacity, TRANSIENT);
-	BAT* edge_src = *out_edge_src = COLnew(0, TYPE_oid, bat_capacity, TRANSIENT);
-	BAT* edge_dst = *out_edge_dst = COLnew(0, TYPE_oid, bat_capacity, TRANSIENT);
-
-	CHECK(candidates != NULL, MAL_MALLOC_FAIL);
-	CHECK(edge_src != NULL, MAL_MALLOC_FAIL);
-	CHECK(edge_dst != NULL, MAL_MALLOC_FAIL);
-
-	for(size_t i = 0; i < end_index; i++){
-		BUNappend(edge_src, in_edge_src + i, false);
-		BUNappend(edge_dst, in_edge_dst + i, false);
-		BUNappend(candidates, in_candidates + i, false);
-	}
+/******************************************************************************
+ *                                                                            *
+ *   Results of the shortest paths, to be validated externally                *
+ *                                                                            *
+ ******************************************************************************/
 
-error: // nop, in case of error the bats are going to be release by the invoker
-	return rc;
-}
+// Size of the buffers to write and read the results
+#define GRAPHsave_BUFFER_SZ (1 << 20) // arbitrary value
 
-#if defined(GRAPHinterjoinlist_SORT)
-// prototypes, core functions of MonetDB
-str ALGsort12(bat *result, bat *norder, const bat *bid, const bit *reverse, const bit *stable);
-str ALGprojection(bat *result, const bat *lid, const bat *rid);
+// Header of the binary format: the magic string followed by the number of queries. Each query is then stored as
+// <from, to, cost, path length, path[0], ..., path[length -1]>, all values 64-bit in the byte order of the machine.
+#define GRAPHsave_BINARY_MAGIC "GR8RES"
 
-// sort the inputs according to candidates
-static str /* private function, do not export as it does not respect the MAL API  */
-GRAPHinterjoinlist_sort(bat* candidates, bat* edges){
-	str rc = MAL_SUCCEED;
-	bat perm = -1;
-	bit reverse = false;
-	bit stable = false;
-
-	rc = ALGsort12(candidates, &perm, candidates, &reverse, &stable);
-	if (rc != NULL) goto error;
-	rc = ALGprojection(edges, &perm, edges);
-	if (rc != NULL) goto error;
-
-	// remove the voids
-	rc = GRAPHvoid2oid(candidates, candidates);
-	if (rc != NULL) goto error;
-	rc = GRAPHvoid2oid(edges, edges);
-	if (rc != NULL) goto error;
-error:
-	return rc;
-}
-#endif
-
-/**
- * Remove tuples with values marked as NULL
- */
-mal_export str
-GRAPHinterjoinlist(bat* out_candidates, bat* out_edge_src, bat* out_edge_dst,
-		bat* in_a, bat* in_b, bat* in_c, bat* in_d){
-	const char* function_name = "graph.intersect_join_lists";
-	str rc = MAL_SUCCEED;
-	BAT *a = NULL, *b = NULL, *c = NULL, *d = NULL; // input
-	BAT *candidates = NULL, *edge_src = NULL, *edge_dst = NULL; // output
-	bool changes = false; // did we remove or alter any element
-	oid* __restrict left = NULL; // left candidate list (array pointer)
-	oid* __restrict right = NULL; // right candidate list (array pointer)
-	oid* __restrict left_src = NULL; // src edges
-	oid* __restrict right_dst = NULL; // dst edges
-	size_t i = 0, j = 0, left_sz = 0, right_sz = 0, min_sz = 0;
-
-/* Macro to acquire a BAT* from a bat */
-#define BATACQUIRE(variable, batptr) \
-    variable = BATdescriptor(*batptr); \
-	CHECK(variable != NULL, RUNTIME_OBJECT_MISSING); \
-	CHECK(ATOMtype(BATttype(variable)) == TYPE_oid, ILLEGAL_ARGUMENT);
-/* End of the macro def */
-
-	// acquire the input candidates
-	BATACQUIRE(a, in_a);
-	BATACQUIRE(b, in_b);
-
-#if !defined(NDEBUG) // DEBUG ONLY: just to check codegen is not messing up with us
-	BATACQUIRE(c, in_c);
-	BBPunfix(c->batCacheid); c = NULL;
-	BATACQUIRE(d, in_d);
-	BBPunfix(d->batCacheid); d = NULL;
-#endif // DEBUG ONLY
-
-#if defined(GRAPHinterjoinlist_SORT)
-	// sort the inputs (if they are not already sorted)
-	if(!a->T.sorted){
-		BBPunfix(a->batCacheid); a = NULL;
-
-		rc = GRAPHinterjoinlist_sort(in_a, in_c);
-		if(rc != NULL) goto error;
-
-		// re-acquire the bat
-		a = BATdescriptor(*in_a);
-		CHECK(a != NULL, RUNTIME_OBJECT_MISSING);
-		CHECK(ATOMtype(BATttype(a)) == TYPE_oid, ILLEGAL_ARGUMENT);
-		assert(a->T.sorted);
-	}
-	if(!b->T.sorted){
-		BBPunfix(b->batCacheid); b = NULL;
-
-		rc = GRAPHinterjoinlist_sort(in_b, in_d);
-		if(rc != NULL) goto error;
-
-		// re-acquire the bat
-		b = BATdescriptor(*in_b);
-		CHECK(b != NULL, RUNTIME_OBJECT_MISSING);
-		CHECK(ATOMtype(BATttype(b)) == TYPE_oid, ILLEGAL_ARGUMENT);
-		assert(b->T.sorted);
-	}
-#else
-	// a is the left candidate list, b is the right candidate list
-	// at this point both input should be sorted
-	CHECK(a->T.sorted, ILLEGAL_ARGUMENT);
-	CHECK(b->T.sorted, ILLEGAL_ARGUMENT);
-#endif
-
-	// acquire the input edges
-	BATACQUIRE(c, in_c);
-	BATACQUIRE(d, in_d);
-
-	left = (oid*) a->T.heap.base;
-	right = (oid*) b->T.heap.base;
-	left_src = (oid*) c->T.heap.base;
-	right_dst = (oid*) d->T.heap.base;
-	left_sz = BATcount(a);
-	right_sz = BATcount(b);
-	min_sz = left_sz < right_sz ? left_sz : right_sz;
-
-	// first loop, skip equal values at the begin
-	for(i = 0; i < min_sz && left[i] == right[i]; i++) /* nop */;
-	j = i;
-
-	// are there still elements to inspect ?
-	if(i < left_sz || j < right_sz) { // uh oh, we need to remove items from the candidate lists
-		rc = GRAPHinterjoinlist_init_changes(&candidates, &edge_src, &edge_dst, min_sz, i, left, left_src, right_dst);
-		if(rc) goto error;
-		assert(candidates != NULL && edge_src != NULL && edge_dst != NULL &&
-				"The BATs should have been initialized by GRAPHinterjoinlist_init_changes");
-		changes = true;
-
-		// perform a merge scan
-		while(i < left_sz && j < right_sz) {
-			if(left[i] == right[j]){
-				BUNappend(edge_src, left_src + i, false);
-				BUNappend(edge_dst, right_dst + j, false);
-				BUNappend(candidates, left + i, false);
-				i++; j++;
-			} else if (left[i] < right[j]) {
-				i++;
-			} else { // left[i] > right[j]
-				j++;
-			}
-		}
-	} // else we are done!
-
-#undef BATACQUIRE
-
-//success:
-	// use the materialized columns as output
-	if(changes){
-		assert(candidates != NULL && edge_src != NULL && edge_dst != NULL);
-
-//		bat_debug(candidates); // DEBUG ONLY
-//		bat_debug(edge_src);
-//		bat_debug(edge_dst);
-
-		// output
-		*out_candidates = candidates->batCacheid;
-		*out_edge_src = edge_src->batCacheid;
-		*out_edge_dst = edge_dst->batCacheid;
-		BBPkeepref(candidates->batCacheid);
-		BBPkeepref(edge_src->batCacheid);
-		BBPkeepref(edge_dst->batCacheid);
-
-		// release the input
-		BBPunfix(a->batCacheid);
-		BBPunfix(b->batCacheid);
-		BBPunfix(c->batCacheid);
-		BBPunfix(d->batCacheid);
-
-	} else { // no changes, keep the same input
-		*out_candidates = a->batCacheid;
-		BBPkeepref(a->batCacheid);
-		BBPunfix(b->batCacheid); // this is equal to 'a'
-		*out_edge_src = c->batCacheid;
-		BBPkeepref(c->batCacheid);
-		*out_edge_dst = d->batCacheid;
-		BBPkeepref(d->batCacheid);
-	}
-
-	return rc;
-error:
-	if(a != NULL) { BBPunfix(a->batCacheid); }
-	if(b != NULL) { BBPunfix(b->batCacheid); }
-	if(c != NULL) { BBPunfix(c->batCacheid); }
-	if(d != NULL) { BBPunfix(d->batCacheid); }
-	if(candidates != NULL) { BBPunfix(candidates->batCacheid); };
-	if(edge_src != NULL) { BBPunfix(edge_src->batCacheid); };
-	if(edge_dst != NULL) { BBPunfix(edge_dst->batCacheid); };
+// Buffered output, in place of fprintf
+typedef struct {
+	FILE* file;
+	char* buffer;
+	size_t pos;
+	bool failed;
+} results_writer_t;
 
-	return rc;
+static void results_writer_flush(results_writer_t* w){
+	if(w->pos > 0 && fwrite(w->buffer, 1, w->pos, w->file) != w->pos) w->failed = true;
+	w->pos = 0;
 }
 
-/**
- *  Load a graph created with the app. graphgen into three bats from, to, weight.
- *  Only required for debugging & testing purposes.
- */
-mal_export str
-GRAPHload(bat* ret_id_from, bat* ret_id_to, bat* ret_id_weights, str* path) {
-	// declarations
-	const char* function_name = "graph.load";
-	str rc = MAL_SUCCEED; // function return code
-	BAT *from = NULL, *to = NULL, *weights = NULL; // created bats
-	const BUN COLnew_initial_capacity = 1024; // arbitrary value
-	FILE* file = NULL;
-	const int buffer_sz = 1024; // arbitrary value
-	char buffer[buffer_sz];
-	char* ptr = NULL; // pointer in the buffer
-	long long int tempc; // for converting input integers
-
-	// create the new bats
-	CHECK(from = COLnew(0, TYPE_oid, COLnew_initial_capacity, TRANSIENT), MAL_MALLOC_FAIL);
-	CHECK(to = COLnew(0, TYPE_oid, COLnew_initial_capacity, TRANSIENT), MAL_MALLOC_FAIL);
-	CHECK(weights = COLnew(0, TYPE_lng, COLnew_initial_capacity, TRANSIENT), MAL_MALLOC_FAIL);
-
-	// open the input file
-	file = fopen(*path, "r");
-	CHECK(file != NULL, RUNTIME_FILE_NOT_FOUND);
-
-	while(!feof(file)){
-		ptr = fgets(buffer, buffer_sz, file);
-		if(ptr == NULL && feof(file)) break; // no characters to extract
-		CHECK(!ferror(file), RUNTIME_STREAM_INPUT);
-
-		char* p = buffer;
-		while(*p && GDKisspace(*p)) p++; // skip empty spaces
-		if(p - buffer >= buffer_sz) continue; // this line contains only spaces
-		if(*p == '#') continue; // comment, skip this line
-
-		tempc = strtoll(p, &ptr, 10); // edge from
-		CHECK(tempc > 0 || (tempc == 0 && p != ptr), RUNTIME_LOAD_ERROR);
-		oid e_from = tempc;
-
-		p = ptr; // move ahead
-		while(*p && GDKisspace(*p)) p++; // skip empty spaces
-		CHECK(p - buffer < buffer_sz, RUNTIME_LOAD_ERROR); // invalid format
-
-		tempc = strtoll(p, &ptr, 10); // edge to
-		CHECK(tempc > 0 || (tempc == 0 && p != ptr), RUNTIME_LOAD_ERROR);
-		oid e_to = tempc;
-
-		p = ptr; // move ahead
-		while(*p && GDKisspace(*p)) p++;  // skip empty spaces
-		CHECK(p - buffer < buffer_sz, RUNTIME_LOAD_ERROR); // invalid format
-
-		tempc = strtoll(p, &ptr, 10); // edge weight
-		CHECK(tempc > 0 || (tempc == 0 && p != ptr), RUNTIME_LOAD_ERROR);
-		BUN e_weight = tempc;
-
-		CHECK(BUNappend(from, &e_from, 0) == GDK_SUCCEED, MAL_MALLOC_FAIL);
-		CHECK(BUNappend(to, &e_to, 0) == GDK_SUCCEED, MAL_MALLOC_FAIL);
-		CHECK(BUNappend(weights, &e_weight, 0) == GDK_SUCCEED, MAL_MALLOC_FAIL);
+static void results_writer_bytes(results_writer_t* w, const void* data, size_t length){
+	if(w->pos + length > GRAPHsave_BUFFER_SZ) results_writer_flush(w);
+	if(length >= GRAPHsave_BUFFER_SZ){ // larger than the buffer, write it directly
+		if(fwrite(data, 1, length, w->file) != length) w->failed = true;
+	} else {
+		memcpy(w->buffer + w->pos, data, length);
+		w->pos += length;
 	}
-
-	fclose(file);
-
-	BBPkeepref(from->batCacheid);
-	BBPkeepref(to->batCacheid);
-	BBPkeepref(weights->batCacheid);
-
-	// Return values
-	*ret_id_from = from->batCacheid;
-	*ret_id_to = to->batCacheid;
-	*ret_id_weights = weights->batCacheid;
-
-	return rc;
-error:
-	// remove the created bats
-	if(from) { BBPunfix(from->batCacheid); }
-	if(to) { BBPunfix(to->batCacheid); }
-	if(weights) { BBPunfix(weights->batCacheid); }
-	if(file) { fclose(file); }
-
-	return rc;
 }
 
-
-/**
- *  Load a set of queries from the given text file
- *  Only required for debugging & testing purposes.
- */
-mal_export str
-GRAPHloadq(bat* ret_id_qfrom, bat* ret_id_qto, str* path) {
-	// declarations
-	const char* function_name = "graph.loadq";
-	str rc = MAL_SUCCEED; // function return code
-	BAT *qfrom = NULL, *qto = NULL; // created bats
-	const BUN COLnew_initial_capacity = 1024; // arbitrary value
-	FILE* file = NULL;
-	const int buffer_sz = 1024; // arbitrary value
-	char buffer[buffer_sz];
-	char* ptr = NULL; // pointer in the buffer
-	long long int tempc; // for converting input integers
-
-	// create the new bats
-	CHECK(qfrom = COLnew(0, TYPE_oid, COLnew_initial_capacity, TRANSIENT), MAL_MALLOC_FAIL);
-	CHECK(qto = COLnew(0, TYPE_oid, COLnew_initial_capacity, TRANSIENT), MAL_MALLOC_FAIL);
-
-	// open the input file
-	file = fopen(*path, "r");
-	CHECK(file != NULL, RUNTIME_FILE_NOT_FOUND);
-
-	while(!feof(file)){
-		ptr = fgets(buffer, buffer_sz, file);
-		if(ptr == NULL && feof(file)) break; // no characters to extract
-		CHECK(!ferror(file), RUNTIME_STREAM_INPUT);
-
-		char* p = buffer;
-		while(*p && GDKisspace(*p)) p++; // skip empty spaces
-		if(p - buffer >= buffer_sz || *p == '\0') continue; // this line only contains spaces
-		if(*p == '#') continue; // comment, skip this line
-
-		tempc = strtoll(p, &ptr, 10); // source
-		CHECK(tempc > 0 || (tempc == 0 && p != ptr), RUNTIME_LOAD_ERROR);
-		oid src = (oid) tempc;
-
-		p = ptr; // move ahead
-
-		while(*p && GDKisspace(*p)) p++; // skip empty spaces
-		CHECK(p - buffer < buffer_sz, RUNTIME_LOAD_ERROR); // invalid format
-
-		tempc = strtoll(p, &ptr, 10); // to
-		CHECK(tempc > 0 || (tempc == 0 && p != ptr), RUNTIME_LOAD_ERROR);
-		oid dst = (oid) tempc;
-
-		CHECK(BUNappend(qfrom, &src, 0) == GDK_SUCCEED, MAL_MALLOC_FAIL);
-		CHECK(BUNappend(qto, &dst, 0) == GDK_SUCCEED, MAL_MALLOC_FAIL);
-	}
-
-	fclose(file);
-
-	// set the bats as read-only. As we are going to scatter them with BATslice, this will allow
-	// to create views instead of full partitioned copies
-	qfrom->S.restricted = BAT_READ;
-	qto->S.restricted = BAT_READ;
-
-	BBPkeepref(qfrom->batCacheid);
-	BBPkeepref(qto->batCacheid);
-
-	// Return values
-	*ret_id_qfrom = qfrom->batCacheid;
-	*ret_id_qto = qto->batCacheid;
-
-	return rc;
-error:
-	// remove the created bats
-	if(qfrom) { BBPunfix(qfrom->batCacheid); }
-	if(qto) { BBPunfix(qto->batCacheid); }
-	if(file) { fclose(file); }
-
-	return rc;
+// Write the decimal representation of the given value
+static void results_writer_uint(results_writer_t* w, uint64_t value){
+	char digits[20];
+	int n = 0;
+	do {
+		digits[n++] = '0' + (value % 10);
+		value /= 10;
+	} while(value > 0);
+
+	if(w->pos + n > GRAPHsave_BUFFER_SZ) results_writer_flush(w);
+	while(n > 0) w->buffer[w->pos++] = digits[--n];
 }
 
+#define results_writer_str(w, str) results_writer_bytes(w, str, sizeof(str) -1)
 
-/**
- * Store the result of the shortest paths to a file in the disk, to be validated externally.
- * Only required for debugging & testing purposes.
- */
-mal_export str
-GRAPHsave(void* dummy, str* path, bat* id_qfrom, bat* id_qto, bat* id_weights, bat* id_poid, bat* id_ppath){
+static str /* PRIVATE FUNCTION */
+GRAPHsave_impl(const char* function_name, str* path, bat* id_qfrom, bat* id_qto, bat* id_weights, bat* id_poid, bat* id_ppath, bool binary){
 	// declarations
-	const char* function_name = "graph.loadq";
 	str rc = MAL_SUCCEED; // function return code
 	BAT *qfrom = NULL, *qto = NULL, *weights = NULL, *poid = NULL, *ppath = NULL;
 	// array accessors
@@ -557,12 +215,7 @@ GRAPHsave(void* dummy, str* path, bat* id_qfrom, bat* id_qto, bat* id_weights, b
 	oid* __restrict appath;
 	BUN q_sz = 0, poid_sz = 0, poid_cur = 0;
 	oid cur_oid; // current value
-	bool first_value; // flag to print a comma at the end of each value
-	FILE* file = NULL;
-
-	// silent the warning from the compiler for the unused parameter
-	// I cannot believe in C they still don't allow nameless parameters, so old
-	(void) dummy;
+	results_writer_t writer = { NULL, NULL, 0, false };
 
 	// access the bat descriptors
 	qfrom = BATdescriptor(*id_qfrom);
@@ -577,11 +230,14 @@ GRAPHsave(void* dummy, str* path, bat* id_qfrom, bat* id_qto, bat* id_weights, b
 	CHECK(ppath != NULL, RUNTIME_OBJECT_MISSING);
 
 	// sanity checks
-	assert(BATcount(qfrom) == BATcount(qto) && "Size mismatch: |qfrom| != |qto|");
-	assert(BATcount(qfrom) == BATcount(weights) && "Size mismatch: |qfrom| != |weights|");
+	CHECK(BATcount(qfrom) == BATcount(qto), ILLEGAL_ARGUMENT ": size mismatch |qfrom| != |qto|");
+	CHECK(BATcount(qfrom) == BATcount(weights), ILLEGAL_ARGUMENT ": size mismatch |qfrom| != |weights|");
+	CHECK(BATcount(poid) == BATcount(ppath), ILLEGAL_ARGUMENT ": size mismatch |poid| != |ppath|");
 
-	file = fopen(*path, "w");
-	CHECK(file != NULL, "Cannot open the output file");
+	writer.file = fopen(*path, binary ? "wb" : "w");
+	CHECK(writer.file != NULL, "Cannot open the output file");
+	writer.buffer = GDKmalloc(GRAPHsave_BUFFER_SZ);
+	CHECK(writer.buffer != NULL, MAL_MALLOC_FAIL);
 
 	aqfrom = (oid*) qfrom->theap.base;
 	aqto = (oid*) qto->theap.base;
@@ -591,38 +247,227 @@ GRAPHsave(void* dummy, str* path, bat* id_qfrom, bat* id_qto, bat* id_weights, b
 	q_sz = BATcount(qfrom);
 	poid_sz = BATcount(poid);
 
+	if(binary){
+		char magic[8] = GRAPHsave_BINARY_MAGIC;
+		uint64_t count = q_sz;
+		results_writer_bytes(&writer, magic, sizeof(magic));
+		results_writer_bytes(&writer, &count, sizeof(count));
+	}
+
 	cur_oid = qfrom->hseqbase;
 
 	for(BUN i = 0; i < q_sz; i++){
-		fprintf(file, "%zu -> %zu [%lu]: ", aqfrom[i], aqto[i], aqweights[i]);
+		BUN path_start, path_end;
 
-		first_value = true;
 		// move to the current oid
 		for( /* resume from the previous run */ ; poid_cur < poid_sz && apoid[poid_cur] < cur_oid; poid_cur++);
-		// print the path
-		for( /* resume from the previous run */ ; poid_cur < poid_sz && apoid[poid_cur] == cur_oid; poid_cur++) {\
-			// print the separator
-			if(first_value){
-				first_value = false;
-			} else {
-				fprintf(file, ", ");
+		path_start = poid_cur;
+		for( /* resume from the previous run */ ; poid_cur < poid_sz && apoid[poid_cur] == cur_oid; poid_cur++);
+		path_end = poid_cur;
+
+		if(binary){
+			uint64_t record[4] = { aqfrom[i], aqto[i], aqweights[i], path_end - path_start };
+			results_writer_bytes(&writer, record, sizeof(record));
+			results_writer_bytes(&writer, appath + path_start, (path_end - path_start) * sizeof(oid));
+		} else { // "%zu -> %zu [%lu]: p0, p1, ..."
+			results_writer_uint(&writer, aqfrom[i]);
+			results_writer_str(&writer, " -> ");
+			results_writer_uint(&writer, aqto[i]);
+			results_writer_str(&writer, " [");
+			results_writer_uint(&writer, aqweights[i]);
+			results_writer_str(&writer, "]: ");
+			for(BUN j = path_start; j < path_end; j++){
+				if(j > path_start) results_writer_str(&writer, ", ");
+				results_writer_uint(&writer, appath[j]);
 			}
-
-			// print the value
-			fprintf(file, "%zu", appath[poid_cur]);
+			results_writer_str(&writer, "\n");
 		}
 
-		fprintf(file, "\n");
 		cur_oid++;
 	}
 
+	results_writer_flush(&writer);
+	CHECK(!writer.failed, RUNTIME_STREAM_WRITE);
+	CHECK(fclose(writer.file) == 0, RUNTIME_STREAM_WRITE);
+	writer.file = NULL;
+
 error:
 	if(qfrom) { BBPunfix(qfrom->batCacheid); }
 	if(qto) { BBPunfix(qto->batCacheid); }
 	if(weights) { BBPunfix(weights->batCacheid); }
 	if(poid) { BBPunfix(poid->batCacheid); }
 	if(ppath) { BBPunfix(ppath->batCacheid); }
-	if(file) { fclose(file); }
+	if(writer.file) { fclose(writer.file); }
+	if(writer.buffer) { GDKfree(writer.buffer); }
+
+	return rc;
+}
+
+/**
+ * Store the result of the shortest paths to a file in the disk, to be validated externally.
+ * Only required for debugging & testing purposes.
+ */
+mal_export str
+GRAPHsave(void* dummy, str* path, bat* id_qfrom, bat* id_qto, bat* id_weights, bat* id_poid, bat* id_ppath){
+	(void) dummy;
+	return GRAPHsave_impl("graph.save", path, id_qfrom, id_qto, id_weights, id_poid, id_ppath, false);
+}
+
+/**
+ * As GRAPHsave, in a compact binary format, to be compared with graph.diff_results
+ */
+mal_export str
+GRAPHsave_binary(void* dummy, str* path, bat* id_qfrom, bat* id_qto, bat* id_weights, bat* id_poid, bat* id_ppath){
+	(void) dummy;
+	return GRAPHsave_impl("graph.save_binary", path, id_qfrom, id_qto, id_weights, id_poid, id_ppath, true);
+}
+
+/**
+ * As GRAPHsave, with the paths in the nested table computed by graph.spfw for the column out_path, one for each query
+ */
+mal_export str
+GRAPHsave_paths(void* dummy, str* path, bat* id_qfrom, bat* id_qto, bat* id_weights, bat* id_paths){
+	const char* function_name = "graph.save";
+	str rc = MAL_SUCCEED;
+	BAT *qfrom = NULL, *paths = NULL, *poid = NULL, *ppath = NULL;
+	const var_t* offsets = NULL;
+	bat id_poid, id_ppath;
+	(void) dummy;
+
+	qfrom = BATdescriptor(*id_qfrom);
+	CHECK(qfrom != NULL, RUNTIME_OBJECT_MISSING);
+	paths = BATdescriptor(*id_paths);
+	CHECK(paths != NULL, RUNTIME_OBJECT_MISSING);
+	CHECK(paths->ttype == ATOMindex("nestedtable") && paths->tvheap != NULL, ILLEGAL_ARGUMENT ": expected the nested table of the paths");
+	CHECK(BATcount(paths) == BATcount(qfrom), ILLEGAL_ARGUMENT ": size mismatch |qfrom| != |paths|");
+
+	// flatten the paths into <poid, ppath>, where poid refers to the position of the query in qfrom
+	poid = COLnew(0, TYPE_oid, 0, TRANSIENT);
+	CHECK(poid != NULL, MAL_MALLOC_FAIL);
+	ppath = COLnew(0, TYPE_oid, 0, TRANSIENT);
+	CHECK(ppath != NULL, MAL_MALLOC_FAIL);
+	offsets = (const var_t*) Tloc(paths, 0);
+	for(BUN i = 0, sz = BATcount(paths); i < sz; i++){
+		const oid* edges = (const oid*) (paths->tvheap->base + offsets[i]); // the length, then the edge ids
+		const oid query = qfrom->hseqbase + i;
+		for(oid j = 1; j <= edges[0]; j++){
+			CHECK(BUNappend(poid, &query, false) == GDK_SUCCEED, MAL_MALLOC_FAIL);
+			CHECK(BUNappend(ppath, &edges[j], false) == GDK_SUCCEED, MAL_MALLOC_FAIL);
+		}
+	}
+
+	id_poid = poid->batCacheid;
+	id_ppath = ppath->batCacheid;
+	rc = GRAPHsave_impl(function_name, path, id_qfrom, id_qto, id_weights, &id_poid, &id_ppath, false);
+
+error:
+	if(qfrom) { BBPunfix(qfrom->batCacheid); }
+	if(paths) { BBPunfix(paths->batCacheid); }
+	if(poid) { BBPunfix(poid->batCacheid); }
+	if(ppath) { BBPunfix(ppath->batCacheid); }
+
+	return rc;
+}
+
+// Buffered input of the binary results
+typedef struct {
+	FILE* file;
+	char* buffer;
+	size_t pos;
+	size_t size;
+	uint64_t unread; // bytes of the file not yet loaded in the buffer
+} results_reader_t;
+
+// Bytes left to read in the file
+static uint64_t results_reader_left(const results_reader_t* r){
+	return r->unread + (r->size - r->pos);
+}
+
+// Read the next `length' bytes, return false if the file is truncated
+static bool results_reader_bytes(results_reader_t* r, void* data, size_t length){
+	char* out = data;
+	while(length > 0){
+		size_t n;
+		if(r->pos == r->size){
+			r->size = fread(r->buffer, 1, GRAPHsave_BUFFER_SZ, r->file);
+			r->pos = 0;
+			r->unread = r->size < r->unread ? r->unread - r->size : 0;
+			if(r->size == 0) return false;
+		}
+		n = r->size - r->pos < length ? r->size - r->pos : length;
+		memcpy(out, r->buffer + r->pos, n);
+		r->pos += n;
+		out += n;
+		length -= n;
+	}
+	return true;
+}
+
+// Read the path of a query into `path', resized as needed. The caller validates its length with results_reader_left
+static bool results_reader_path(results_reader_t* r, uint64_t length, oid** path, uint64_t* capacity){
+	if(length > *capacity){
+		oid* resized = GDKrealloc(*path, length * sizeof(oid));
+		if(resized == NULL) return false;
+		*path = resized;
+		*capacity = length;
+	}
+	return results_reader_bytes(r, *path, length * sizeof(oid));
+}
+
+/**
+ * Compare two result files written by graph.save_binary and return the number of queries that differ in their
+ * vertices or cost, or also in their path if `compare_paths' is set. Paths with the same cost may legitimately
+ * differ between two correct runs.
+ */
+mal_export str
+GRAPHdiff_results(lng* result, str* path1, str* path2, bit* compare_paths){
+	const char* function_name = "graph.diff_results";
+	str rc = MAL_SUCCEED;
+	results_reader_t readers[2] = { { NULL, NULL, 0, 0, 0 }, { NULL, NULL, 0, 0, 0 } };
+	str paths[2] = { *path1, *path2 };
+	uint64_t counts[2];
+	oid* qpath[2] = { NULL, NULL };
+	uint64_t qpath_capacity[2] = { 0, 0 };
+	uint64_t num_differences = 0;
+
+	for(int i = 0; i < 2; i++){
+		char magic[8];
+		struct stat file_stat;
+		readers[i].file = fopen(paths[i], "rb");
+		CHECK(readers[i].file != NULL, RUNTIME_FILE_NOT_FOUND);
+		CHECK(fstat(fileno(readers[i].file), &file_stat) == 0, RUNTIME_STREAM_INPUT);
+		readers[i].unread = file_stat.st_size;
+		readers[i].buffer = GDKmalloc(GRAPHsave_BUFFER_SZ);
+		CHECK(readers[i].buffer != NULL, MAL_MALLOC_FAIL);
+		CHECK(results_reader_bytes(&readers[i], magic, sizeof(magic)) && strncmp(magic, GRAPHsave_BINARY_MAGIC, sizeof(magic)) == 0, RUNTIME_LOAD_ERROR ": not a binary result file");
+		CHECK(results_reader_bytes(&readers[i], &counts[i], sizeof(counts[i])), RUNTIME_LOAD_ERROR ": truncated file");
+	}
+
+	// queries missing in either file
+	num_differences = counts[0] > counts[1] ? counts[0] - counts[1] : counts[1] - counts[0];
+
+	for(uint64_t q = 0, sz = counts[0] < counts[1] ? counts[0] : counts[1]; q < sz; q++){
+		uint64_t records[2][4];
+		for(int i = 0; i < 2; i++){
+			CHECK(results_reader_bytes(&readers[i], records[i], sizeof(records[i])), RUNTIME_LOAD_ERROR ": truncated file");
+			CHECK(records[i][3] <= SIZE_MAX / sizeof(oid) && records[i][3] * sizeof(oid) <= results_reader_left(&readers[i]), RUNTIME_LOAD_ERROR ": invalid length of a path");
+			CHECK(results_reader_path(&readers[i], records[i][3], &qpath[i], &qpath_capacity[i]), RUNTIME_LOAD_ERROR ": truncated file");
+		}
+
+		if(memcmp(records[0], records[1], 3 * sizeof(uint64_t)) != 0 || // from, to, cost
+				(*compare_paths && (records[0][3] != records[1][3] || memcmp(qpath[0], qpath[1], records[0][3] * sizeof(oid)) != 0))){
+			num_differences++;
+		}
+	}
+
+	*result = (lng) num_differences;
+
+error:
+	for(int i = 0; i < 2; i++){
+		if(readers[i].file) { fclose(readers[i].file); }
+		if(readers[i].buffer) { GDKfree(readers[i].buffer); }
+		if(qpath[i]) { GDKfree(qpath[i]); }
+	}
 
 	return rc;
 }
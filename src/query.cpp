@@ -24,14 +24,14 @@ using namespace std;
  *                                                                            *
  ******************************************************************************/
 
-ShortestPath::ShortestPath(Query* q, BatHandle&& weights, int pos_output, int pos_path) :
-	_query(q), _initialised(false), _pos_output_cost(pos_output), _pos_output_path(pos_path), weights(move(weights)) {
+ShortestPath::ShortestPath(Query* q, BatHandle&& weights, int pos_output, int pos_path, lng bound) :
+	_query(q), _initialised(false), _pos_output_cost(pos_output), _pos_output_path(pos_path), _bound(bound), weights(move(weights)) {
 
 }
 
 void ShortestPath::initialise(std::size_t capacity){
 	assert(!initialised());
-	computed_cost = COLnew(0, !bfs() ? weights.type() : TYPE_lng /* keep in sync with edge::cost_t */, capacity, TRANSIENT);
+	computed_cost = COLnew(0, cost_type(), capacity, TRANSIENT);
 	if(!computed_cost.initialised()){ RAISE_ERROR("Cannot initialized the array computed_cost with capacity: " << capacity); }
 
 	if(compute_path()){
@@ -51,6 +51,19 @@ void ShortestPath::initialise(std::size_t capacity){
 	_initialised = true;
 }
 
+int ShortestPath::cost_type() const {
+	if(bfs()) return TYPE_lng; // number of hops
+	int type = ATOMtype(weights.type());
+	switch(type){
+	case TYPE_bte:
+	case TYPE_sht:
+	case TYPE_int:
+		return TYPE_lng; // like sum(), the costs of long paths easily exceed the domain of the weights
+	default:
+		return type;
+	}
+}
+
 bool ShortestPath::initialised() const {
 	return _initialised;
 }
@@ -108,6 +121,14 @@ void ShortestPath::append_path0(const vector<oid>& path, bool reversed){
 	output->batCount++;
 }
 
+void ShortestPath::append_nil(){
+	assert(initialised());
+	BUNappend(computed_cost.get(), ATOMnilptr(computed_cost.get()->ttype), false);
+	if(compute_path()){
+		append_path0(vector<oid>{}, false);
+	}
+}
+
 bool ShortestPath::bfs() const{ // do we need to perform a BFS visit?
 //	return ((bool) weights) == false;
 	return weights.initialised() == false;
@@ -117,6 +138,15 @@ bool ShortestPath::compute_path() const {
 	return _pos_output_path != -1;
 }
 
+bool ShortestPath::bounded() const {
+	return _bound >= 0;
+}
+
+lng ShortestPath::bound() const {
+	CHECK_EXCEPTION(Exception, bounded(), "Unbounded shortest path");
+	return _bound;
+}
+
 int ShortestPath::get_pos_cost() const {
 	return _pos_output_cost;
 }
@@ -138,8 +168,8 @@ Query::Query() : _joined(false), _pos_output_left(0), _pos_output_right(1), oper
 
 Query::~Query() { }
 
-void Query::request_shortest_path(BatHandle&& weights, int pos_output, int pos_path){
-	shortest_paths.push_back( ShortestPath{this, move(weights), pos_output, pos_path} );
+void Query::request_shortest_path(BatHandle&& weights, int pos_output, int pos_path, lng bound){
+	shortest_paths.push_back( ShortestPath{this, move(weights), pos_output, pos_path, bound} );
 }
 
 bool Query::is_joined() const {
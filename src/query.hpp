@@ -36,8 +36,9 @@ private:
 	bool _initialised;
 	int _pos_output_cost;
 	int _pos_output_path;
+	lng _bound; // max cost of the paths to report, -1 if unbounded
 
-	ShortestPath(Query* q, BatHandle&& weights, int pos_output_cost, int pos_output_path);
+	ShortestPath(Query* q, BatHandle&& weights, int pos_output_cost, int pos_output_path, lng bound);
 
 	void append_cost0(void* value);
 	void append_path0(const std::vector<oid>& path, bool reversed);
@@ -50,12 +51,19 @@ public:
 	void initialise(std::size_t capacity);
 	bool initialised() const;
 
+	// type of the column computed_cost, keep in sync with algorithm::sequential::CostDijkstra
+	int cost_type() const;
+
 	// do we need to perform a BFS visit?
 	bool bfs() const;
 
 	// do we need to report the path ?
 	bool compute_path() const;
 
+	// are we only interested in paths with a cost up to bound() ?
+	bool bounded() const;
+	lng bound() const;
+
 	int get_pos_cost() const;
 	int get_pos_path() const;
 
@@ -68,6 +76,9 @@ public:
 	void append(const std::vector<oid>& path, bool reversed = true){
 		append_path0(path, reversed);
 	}
+
+	// report a pair that is not connected within the bound
+	void append_nil();
 };
 
 /******************************************************************************
@@ -115,14 +126,14 @@ public:
 		return query_src.empty();
 	}
 
-	void request_shortest_path(BatHandle&& weights, int pos_output, int pos_path);
+	void request_shortest_path(BatHandle&& weights, int pos_output, int pos_path, lng bound = -1);
 
 	oid qsrc(std::size_t index) const{
-		return query_src.array<oid>()[index];
+		return query_src.oids()[index];
 	}
 
 	oid qdst(std::size_t index) const{
-		return query_dst.array<oid>()[index];
+		return query_dst.oids()[index];
 	}
 
 	bool is_joined() const;
@@ -0,0 +1,265 @@
+/**
+ * Binary snapshot of a graph in its compact form, as produced by graph.make. The file is a header followed by
+ * the offsets of the vertices, the destinations of the edges, their original ids and optionally their weights,
+ * each section stored as a plain array in the byte order of the machine that wrote it.
+ */
+
+#include "common.h"
+
+// System includes
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// MonetDB includes
+#include <gdk.h>
+
+// Graph library includes
+#include "debug.h"
+
+#define GRAPH_SNAPSHOT_MAGIC "GR8SNAP"
+#define GRAPH_SNAPSHOT_VERSION 1
+
+// Number of oids materialised at the time when writing a dense column
+#define GRAPH_SNAPSHOT_CHUNK 4096 // arbitrary value
+
+typedef struct {
+	char magic[8]; // GRAPH_SNAPSHOT_MAGIC
+	uint32_t version; // GRAPH_SNAPSHOT_VERSION
+	uint32_t weight_size; // width of a weight, in bytes, 0 if the graph is unweighted
+	char weight_type[16]; // name of the atom of the weights
+	uint64_t vertex_count;
+	uint64_t edge_count;
+} snapshot_header_t;
+
+// Whether the weights can be stored in a snapshot: a numeric type, of fixed size
+static bool snapshot_weight_type(int type){
+	if(type < 0 || ATOMvarsized(type)) return false;
+	switch(type){
+	case TYPE_bte:
+	case TYPE_sht:
+	case TYPE_int:
+	case TYPE_lng:
+#ifdef HAVE_HGE
+	case TYPE_hge:
+#endif
+	case TYPE_flt:
+	case TYPE_dbl:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Set *result = a * b + c, return false if it overflows
+static bool snapshot_muladd(uint64_t a, uint64_t b, uint64_t c, uint64_t* result){
+	if(b != 0 && a > (UINT64_MAX - c) / b) return false;
+	*result = a * b + c;
+	return true;
+}
+
+// Write the values of a column of oids, materialising a dense column
+static bool snapshot_write_oids(FILE* file, BAT* b){
+	BUN count = BATcount(b);
+
+	if(b->T.type == TYPE_void){
+		oid buffer[GRAPH_SNAPSHOT_CHUNK];
+		oid value = b->T.seq;
+		for(BUN i = 0; i < count; ){
+			BUN n = 0;
+			for( ; n < GRAPH_SNAPSHOT_CHUNK && i < count; n++, i++) buffer[n] = value++;
+			if(fwrite(buffer, sizeof(oid), n, file) != n) return false;
+		}
+		return true;
+	} else {
+		return fwrite(Tloc(b, 0), sizeof(oid), count, file) == count;
+	}
+}
+
+// Read `count' values of the given type into a new column
+static BAT* snapshot_read_column(FILE* file, int type, BUN count){
+	BAT* b = COLnew(0, type, count, TRANSIENT);
+	if(b == NULL) return NULL;
+	if(fread(Tloc(b, 0), ATOMsize(type), count, file) != count){
+		BBPunfix(b->batCacheid);
+		return NULL;
+	}
+	BATsetcount(b, count);
+	b->tsorted = b->trevsorted = b->tkey = count <= 1;
+	b->tnonil = 1; b->tnil = 0;
+	return b;
+}
+
+// Check the loaded graph is well formed before it reaches the searches: the offsets are non decreasing and end at
+// the number of edges, the destinations are vertices and the ids are positions of the edges
+static bool snapshot_valid_graph(BAT* vertices, BAT* edges, BAT* ids){
+	const oid* offsets = (const oid*) Tloc(vertices, 0);
+	const oid* destinations = (const oid*) Tloc(edges, 0);
+	const oid* positions = (const oid*) Tloc(ids, 0);
+	BUN vertex_count = BATcount(vertices);
+	BUN edge_count = BATcount(edges);
+
+	for(BUN i = 0; i < vertex_count; i++){
+		if(offsets[i] < (i == 0 ? 0 : offsets[i -1])) return false;
+	}
+	if(vertex_count == 0 ? edge_count != 0 : offsets[vertex_count -1] != edge_count) return false;
+	for(BUN i = 0; i < edge_count; i++){
+		if(destinations[i] >= vertex_count || positions[i] >= edge_count) return false;
+	}
+
+	return true;
+}
+
+static str
+snapshot_save(str* path, bat* id_vertices, bat* id_edges, bat* id_ids, bat* id_weights /* nullable */, lng* vertex_count){
+	const char* function_name = "graph.snapshot_save";
+	str rc = MAL_SUCCEED;
+	BAT *vertices = NULL, *edges = NULL, *ids = NULL, *weights = NULL;
+	FILE* file = NULL;
+	snapshot_header_t header;
+
+	vertices = BATdescriptor(*id_vertices);
+	CHECK(vertices != NULL, RUNTIME_OBJECT_MISSING);
+	edges = BATdescriptor(*id_edges);
+	CHECK(edges != NULL, RUNTIME_OBJECT_MISSING);
+	ids = BATdescriptor(*id_ids);
+	CHECK(ids != NULL, RUNTIME_OBJECT_MISSING);
+	if(id_weights){
+		weights = BATdescriptor(*id_weights);
+		CHECK(weights != NULL, RUNTIME_OBJECT_MISSING);
+	}
+
+	// sanity checks
+	CHECK(*vertex_count >= 0 && BATcount(vertices) == (BUN) *vertex_count, ILLEGAL_ARGUMENT ": the offsets do not match the number of vertices");
+	CHECK(BATcount(edges) == BATcount(ids), ILLEGAL_ARGUMENT ": the edge ids do not match the number of edges");
+	CHECK(weights == NULL || BATcount(weights) == BATcount(edges), ILLEGAL_ARGUMENT ": the weights do not match the number of edges");
+	CHECK(vertices->T.type == TYPE_oid && edges->T.type == TYPE_oid, ILLEGAL_ARGUMENT ": expected the columns of graph.make");
+	CHECK(weights == NULL || (snapshot_weight_type(weights->T.type) && strlen(ATOMname(weights->T.type)) < sizeof(header.weight_type)), ILLEGAL_ARGUMENT ": invalid type for the weights");
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, GRAPH_SNAPSHOT_MAGIC, sizeof(GRAPH_SNAPSHOT_MAGIC));
+	header.version = GRAPH_SNAPSHOT_VERSION;
+	if(weights){
+		header.weight_size = ATOMsize(weights->T.type);
+		strcpy(header.weight_type, ATOMname(weights->T.type));
+	}
+	header.vertex_count = BATcount(vertices);
+	header.edge_count = BATcount(edges);
+
+	file = fopen(*path, "wb");
+	CHECK(file != NULL, "Cannot open the output file");
+	CHECK(fwrite(&header, sizeof(header), 1, file) == 1, RUNTIME_STREAM_WRITE);
+	CHECK(snapshot_write_oids(file, vertices), RUNTIME_STREAM_WRITE);
+	CHECK(snapshot_write_oids(file, edges), RUNTIME_STREAM_WRITE);
+	CHECK(snapshot_write_oids(file, ids), RUNTIME_STREAM_WRITE);
+	if(weights){
+		CHECK(fwrite(Tloc(weights, 0), header.weight_size, BATcount(weights), file) == BATcount(weights), RUNTIME_STREAM_WRITE);
+	}
+	CHECK(fclose(file) == 0, RUNTIME_STREAM_WRITE);
+	file = NULL;
+
+error:
+	BATfree(vertices);
+	BATfree(edges);
+	BATfree(ids);
+	BATfree(weights);
+	if(file) { fclose(file); }
+
+	return rc;
+}
+
+mal_export str
+GRAPHsnapshot_save(void* dummy, str* path, bat* id_vertices, bat* id_edges, bat* id_ids, bat* id_weights, lng* vertex_count){
+	(void) dummy;
+	return snapshot_save(path, id_vertices, id_edges, id_ids, id_weights, vertex_count);
+}
+
+mal_export str
+GRAPHsnapshot_save_unweighted(void* dummy, str* path, bat* id_vertices, bat* id_edges, bat* id_ids, lng* vertex_count){
+	(void) dummy;
+	return snapshot_save(path, id_vertices, id_edges, id_ids, NULL, vertex_count);
+}
+
+/*
+ * Load a snapshot into the columns <vertices, edges, ids[, weights], vertex_count>, to be passed to spfw through
+ * <graph type="compact">. The weights are returned when requested and with the type stored in the snapshot.
+ */
+mal_export str
+GRAPHsnapshot_load(void* cntxt, MalBlkPtr mb, MalStkPtr stk, InstrPtr p){
+	const char* function_name = "graph.snapshot_load";
+	str rc = MAL_SUCCEED;
+	BAT *vertices = NULL, *edges = NULL, *ids = NULL, *weights = NULL;
+	FILE* file = NULL;
+	snapshot_header_t header;
+	str* path = NULL;
+	bool weighted = false;
+	int weight_type = -1;
+	long file_sz = 0;
+	uint64_t expected_sz = 0;
+
+	(void) cntxt;
+	(void) mb;
+
+	// validate the input parameters
+	CHECK(p->retc == 4 || p->retc == 5, ILLEGAL_ARGUMENT ": Expected 4 or 5 return parameters");
+	CHECK(p->argc - p->retc == 1, ILLEGAL_ARGUMENT ": Expected exactly one input parameter");
+	weighted = p->retc == 5;
+	path = (str*) getArgReference(stk, p, p->retc);
+
+	file = fopen(*path, "rb");
+	CHECK(file != NULL, RUNTIME_FILE_NOT_FOUND);
+	CHECK(fread(&header, sizeof(header), 1, file) == 1, RUNTIME_LOAD_ERROR ": truncated header");
+	CHECK(memcmp(header.magic, GRAPH_SNAPSHOT_MAGIC, sizeof(GRAPH_SNAPSHOT_MAGIC)) == 0, RUNTIME_LOAD_ERROR ": not a graph snapshot");
+	CHECK(header.version == GRAPH_SNAPSHOT_VERSION, RUNTIME_LOAD_ERROR ": unsupported version of the snapshot");
+	CHECK(!weighted || header.weight_size > 0, RUNTIME_LOAD_ERROR ": the snapshot does not contain the weights");
+	if(weighted){
+		header.weight_type[sizeof(header.weight_type) -1] = '\0';
+		weight_type = ATOMindex(header.weight_type);
+		CHECK(snapshot_weight_type(weight_type) && ATOMsize(weight_type) == header.weight_size, RUNTIME_LOAD_ERROR ": invalid type for the weights");
+	}
+
+	// check the size of the file before allocating the columns
+	CHECK(fseek(file, 0, SEEK_END) == 0 && (file_sz = ftell(file)) >= 0, RUNTIME_STREAM_INPUT);
+	CHECK(snapshot_muladd(header.vertex_count, sizeof(oid), sizeof(header), &expected_sz) &&
+			snapshot_muladd(header.edge_count, 2 * sizeof(oid), expected_sz, &expected_sz) &&
+			snapshot_muladd(header.edge_count, header.weight_size, expected_sz, &expected_sz) &&
+			(uint64_t) file_sz == expected_sz, RUNTIME_LOAD_ERROR ": the size of the file does not match its header");
+	CHECK(fseek(file, sizeof(header), SEEK_SET) == 0, RUNTIME_STREAM_INPUT);
+
+	// read the sections
+	CHECK(vertices = snapshot_read_column(file, TYPE_oid, header.vertex_count), MAL_MALLOC_FAIL);
+	CHECK(edges = snapshot_read_column(file, TYPE_oid, header.edge_count), MAL_MALLOC_FAIL);
+	CHECK(ids = snapshot_read_column(file, TYPE_oid, header.edge_count), MAL_MALLOC_FAIL);
+	CHECK(snapshot_valid_graph(vertices, edges, ids), RUNTIME_LOAD_ERROR ": invalid offsets, edges or ids in the snapshot");
+	vertices->tsorted = 1;
+	if(weighted){
+		CHECK(weights = snapshot_read_column(file, weight_type, header.edge_count), MAL_MALLOC_FAIL);
+		weights->tnonil = 0; // not known
+	}
+
+	fclose(file);
+	file = NULL;
+
+	// return values
+	BBPkeepref(vertices->batCacheid);
+	stk->stk[p->argv[0]].val.bval = vertices->batCacheid;
+	BBPkeepref(edges->batCacheid);
+	stk->stk[p->argv[1]].val.bval = edges->batCacheid;
+	BBPkeepref(ids->batCacheid);
+	stk->stk[p->argv[2]].val.bval = ids->batCacheid;
+	if(weighted){
+		BBPkeepref(weights->batCacheid);
+		stk->stk[p->argv[3]].val.bval = weights->batCacheid;
+	}
+	*((lng*) getArgReference(stk, p, p->retc -1)) = (lng) header.vertex_count;
+
+	return rc;
+error:
+	BATfree(vertices);
+	BATfree(edges);
+	BATfree(ids);
+	BATfree(weights);
+	if(file) { fclose(file); }
+
+	return rc;
+}
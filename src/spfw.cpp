@@ -1,4 +1,4 @@
-#include <iostream>
+#include <memory>
 #include <string>
 
 #include "debug.h"
@@ -59,6 +59,28 @@ static void handle_request(Query& query){
 	}
 }
 
+// Build the compact form of the graph <in_src, in_dst, in_weights>, the weights are optional
+static void make_graph(bat* out_vertices, bat* out_edges, bat* out_ids, bat* out_weights, lng* out_count,
+		const bat* in_src, const bat* in_dst, const bat* in_weights){
+	BatHandle edge_src{*in_src};
+	BatHandle edge_dst{*in_dst};
+	MAL_ASSERT_MSG(edge_src.size() == edge_dst.size(), ILLEGAL_ARGUMENT, "The columns `from' and `to' have a different size: " << edge_src.size() << " != " << edge_dst.size());
+	BatHandle weights;
+	if(in_weights != nullptr){
+		weights = BatHandle{*in_weights};
+		MAL_ASSERT_MSG(weights.size() == edge_src.size(), ILLEGAL_ARGUMENT, "The column `weights' has " << weights.size() << " values, expected one for each edge: " << edge_src.size());
+	}
+
+	GraphDescriptorColumns graph { move(edge_src), move(edge_dst) };
+	unique_ptr<GraphDescriptorCompact> compact { make_compact_graph(&graph, in_weights != nullptr ? &weights : nullptr) };
+
+	*out_vertices = compact->edge_src.release_logical();
+	*out_edges = compact->edge_dst.release_logical();
+	*out_ids = compact->edge_id.release_logical();
+	if(out_weights != nullptr){ *out_weights = weights.release_logical(); }
+	*out_count = (lng) compact->vertex_count;
+}
+
 
 /******************************************************************************
  *                                                                            *
@@ -121,16 +143,27 @@ str GRAPHspfw(void* cntxt, MalBlkPtr mb, MalStkPtr stackPtr, InstrPtr instrPtr)
 		}
 
 	} catch(gr8::Exception& e){ // internal exception
-		if(dynamic_cast<gr8::MalException*>(&e)){
-			rc = createException(MAL, function_name, "%s", ((MalException*) &e)->get_mal_error());
-		} else {
-			rc = createException(MAL, function_name, OPERATION_FAILED);
-		}
+		rc = handle_exception(function_name, e);
+		goto error;
+	} catch(std::bad_alloc& b) {
+		CHECK(0, MAL_MALLOC_FAIL);
+	} catch(...) { // no exception shall pass
+		CHECK(0, OPERATION_FAILED); // generic error
+	}
 
-		cerr << ">> Exception " << e.getExceptionClass() << " raised at " << e.getFile() << ", line: " << e.getLine() << "\n";
-		cerr << ">> Cause: " << e.what() << "\n";
-		cerr << ">> Operation failed!" << endl;
+error:
+	return rc;
+}
 
+static str GRAPHmake_impl(bat* out_vertices, bat* out_edges, bat* out_ids, bat* out_weights, lng* out_count,
+		const bat* in_src, const bat* in_dst, const bat* in_weights) noexcept {
+	str rc = MAL_SUCCEED;
+	const char* function_name = "graph.make";
+
+	try {
+		make_graph(out_vertices, out_edges, out_ids, out_weights, out_count, in_src, in_dst, in_weights);
+	} catch(gr8::Exception& e){ // internal exception
+		rc = handle_exception(function_name, e);
 		goto error;
 	} catch(std::bad_alloc& b) {
 		CHECK(0, MAL_MALLOC_FAIL);
@@ -141,4 +174,15 @@ str GRAPHspfw(void* cntxt, MalBlkPtr mb, MalStkPtr stackPtr, InstrPtr instrPtr)
 error:
 	return rc;
 }
+
+// Compact form of a weighted graph, to be passed to spfw through <graph type="compact">
+str GRAPHmake(bat* out_vertices, bat* out_edges, bat* out_ids, bat* out_weights, lng* out_count,
+		const bat* in_src, const bat* in_dst, const bat* in_weights) noexcept {
+	return GRAPHmake_impl(out_vertices, out_edges, out_ids, out_weights, out_count, in_src, in_dst, in_weights);
+}
+
+// Compact form of an unweighted graph
+str GRAPHmake_unweighted(bat* out_vertices, bat* out_edges, bat* out_ids, lng* out_count, const bat* in_src, const bat* in_dst) noexcept {
+	return GRAPHmake_impl(out_vertices, out_edges, out_ids, nullptr, out_count, in_src, in_dst, nullptr);
+}
 } // extern "C"